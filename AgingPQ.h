@@ -0,0 +1,167 @@
+#ifndef AGING_PQ_H
+#define AGING_PQ_H
+
+#include "dsexceptions.h"
+#include "PQ.h"
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// AgingPQ class
+//
+// A priority queue whose tasks belong to a fixed number of classes that
+// can be aged independently, e.g. to let background work catch up with
+// interactive work at its own rate. Each class is a PQ, so aging a class
+// is O(1) through PQ::ageAll; deleteMin compares the class minima, in
+// O(classes + log n). Tasks of equal priority in different classes leave
+// lowest class first.
+//
+// Template parameters: ID (must be hashable with std::hash), P (priority type, default int)
+// Constructors:
+// AgingPQ( classes, stable ) --> constructs an empty queue with the given number of
+//                                classes; if stable, each class is FIFO among equal priorities
+// ******************PUBLIC OPERATIONS*********************
+// void insert( x, p, c )          --> Insert task ID x with priority p into class c (if x is queued, as updatePriority)
+// ID findMin( )                   --> Return a task ID with smallest priority, without removing it
+// P findMinPriority( )            --> Return the smallest priority, without removing it
+// ID deleteMin( )                 --> Remove and return a task ID with smallest priority
+// void updatePriority( x, p, c )  --> Move ID x to class c with priority p (if x not queued, inserts x)
+// void remove( x )                --> Remove task ID x; nothing is done if x is not in the queue
+// bool contains( x )              --> Return true if task ID x is in the queue
+// int classOf( x )                --> Return the class of ID x, or -1 if x is not queued
+// void ageClass( c, delta )       --> Lower the priority of every task of class c by delta, in O(1)
+// void ageAll( delta )            --> Lower every queued priority by delta, in O(classes)
+// int classCount( )               --> Return the number of classes
+// bool isEmpty( )                 --> Return true if empty; else false
+// int size( )                     --> Return the number of task IDs in the queue
+// ******************ERRORS********************************
+// Throws UnderflowException as warranted
+// Throws IllegalArgumentException for a class outside [0, classes) or a negative delta
+
+template <typename ID, typename P = int>
+class AgingPQ {
+
+  public:
+
+    // Constructor
+    // Initializes an empty queue with classes classes (at least one)
+    explicit AgingPQ( int classes, bool stable = false ) {
+      if (classes < 1) {
+        throw IllegalArgumentException{ };
+      }
+      lanes.reserve(classes);
+      for (int c = 0; c < classes; c++) {
+        lanes.emplace_back(stable);
+      }
+    }
+
+    int classCount() const { return lanes.size(); }
+
+    bool isEmpty() const { return where.empty(); }
+
+    int size() const { return where.size(); }
+
+    // Returns true if ID x is in the queue
+    bool contains( const ID & x ) const {
+      return where.count(x) > 0;
+    }
+
+    // Return the class of ID x, or -1 if x is not in the queue
+    int classOf( const ID & x ) const {
+      typename unordered_map<ID, int>::const_iterator it = where.find(x);
+      return it == where.end() ? -1 : it->second;
+    }
+
+    // Insert ID x with priority p into class c
+    //    If x is already queued, in any class, it is moved as by updatePriority
+    void insert( const ID & x, P p, int c ) {
+      if (contains(x)) {
+        updatePriority(x, p, c);
+        return;
+      }
+      lanes[checked(c)].insert(x, p);
+      where[x] = c;
+    }
+
+    // Returns an ID with minimum priority without removing it
+    //     Throws exception if queue is empty
+    const ID & findMin() const {
+      return lanes[minClass()].findMin();
+    }
+
+    // Returns the minimum priority without removing its task
+    //     Throws exception if queue is empty
+    P findMinPriority() const {
+      return lanes[minClass()].findMinPriority();
+    }
+
+    // Deletes and Returns a task ID with minimum priority
+    //    Throws exception if queue is empty
+    ID deleteMin() {
+      ID x = lanes[minClass()].deleteMin();
+      where.erase(x);
+      return x;
+    }
+
+    // Give ID x priority p in class c
+    //    Inserts x if not in the queue
+    void updatePriority( const ID & x, P p, int c ) {
+      checked(c);
+      int current = classOf(x);
+      if (current >= 0 && current != c) {
+        lanes[current].remove(x);
+      }
+      lanes[c].updatePriority(x, p);
+      where[x] = c;
+    }
+
+    // Remove ID x from the queue; nothing is done if x is not in the queue
+    void remove( const ID & x ) {
+      typename unordered_map<ID, int>::iterator it = where.find(x);
+      if (it == where.end()) {
+        return;
+      }
+      lanes[it->second].remove(x);
+      where.erase(it);
+    }
+
+    // Lower the priority of every task currently in class c by delta
+    void ageClass( int c, P delta ) {
+      lanes[checked(c)].ageAll(delta);
+    }
+
+    // Lower the priority of every queued task by delta
+    void ageAll( P delta ) {
+      for (size_t c = 0; c < lanes.size(); c++) {
+        lanes[c].ageAll(delta);
+      }
+    }
+
+  private:
+
+    vector<PQ<ID, P>> lanes;       // one queue per class
+    unordered_map<ID, int> where;  // class of each queued ID
+
+    int checked( int c ) const {
+      if (c < 0 || c >= (int) lanes.size()) {
+        throw IllegalArgumentException{ };
+      }
+      return c;
+    }
+
+    // Class holding the smallest priority; throws if every class is empty
+    int minClass() const {
+      int best = -1;
+      for (size_t c = 0; c < lanes.size(); c++) {
+        if (!lanes[c].isEmpty()
+            && (best < 0 || lanes[c].findMinPriority() < lanes[best].findMinPriority())) {
+          best = c;
+        }
+      }
+      if (best < 0) {
+        throw UnderflowException{ };
+      }
+      return best;
+    }
+};
+#endif
@@ -0,0 +1,278 @@
+#ifndef ASYNC_PQ_H
+#define ASYNC_PQ_H
+
+#include "dsexceptions.h"
+#include "PQ.h"
+#include <coroutine>
+#include <functional>
+#include <mutex>
+#include <vector>
+using namespace std;
+
+// AsyncPQ class
+//
+// A thread-safe PQ for C++20 coroutine consumers: co_await queue.pop( )
+// takes a task ID with smallest priority, suspending the coroutine while
+// the queue is empty instead of blocking a thread. Suspended consumers
+// wait in a stable PQ of their own, ordered by the waiter priority given
+// to pop (smaller first, FIFO among equals). When insert or
+// updatePriority makes tasks available, each is handed to the next
+// waiter under the lock, and the woken waiters are resumed together
+// after the lock is released: on the calling thread, or, if the queue was
+// given an executor, by passing each handle to it (e.g. to resume them on
+// a consumer thread).
+//
+// A consumer suspended in pop must not be destroyed before it resumes.
+//
+// Template parameters: ID, P (priority type, default int)
+// Constructors:
+// AsyncPQ( stable ) --> constructs a new empty queue; if stable, equal priorities leave in FIFO order
+// AsyncPQ( executor, stable ) --> as above; woken consumers are handed to executor instead of resumed inline
+// ******************PUBLIC OPERATIONS*********************
+// awaitable pop( w )                     --> co_await: remove a task ID with smallest priority,
+//                                            waiting with waiter priority w (default 0) if empty
+// void insert( x, p )                    --> Insert task ID x with priority p
+// void insertBatch( tasks, priorities )  --> updatePriority( tasks[i], priorities[i] ) for each i; one lock and one wakeup pass
+// void updatePriority( x, p )            --> Changes priority of ID x to p (if x not queued, inserts x)
+// bool tryPop( out )                     --> Pop a task ID into out without waiting; false if none
+// bool remove( x )                       --> Remove task ID x; return false if x was not queued
+// void shutdown( )                       --> Resume all waiters; pop throws from then on when empty
+// bool isEmpty( )                        --> Return true if no tasks are queued; else false
+// int size( )                            --> Return the number of queued task IDs
+// int waiting( )                         --> Return the number of suspended consumers
+// ******************ERRORS********************************
+// co_await pop( ) throws UnderflowException once the queue is shut down and empty
+//
+// DetachedTask is a minimal fire-and-forget coroutine return type for
+// consumers: the coroutine starts at once and frees itself when it finishes.
+
+struct DetachedTask {
+    struct promise_type {
+      DetachedTask get_return_object() { return DetachedTask(); }
+      suspend_never initial_suspend() noexcept { return suspend_never(); }
+      suspend_never final_suspend() noexcept { return suspend_never(); }
+      void return_void() {}
+      void unhandled_exception() { terminate(); }
+    };
+};
+
+template <typename ID, typename P = int>
+class AsyncPQ {
+
+  public:
+
+    class PopAwaiter;
+
+    // Constructor
+    // Initializes a new empty queue
+    explicit AsyncPQ( bool stable = false ) : queue(stable), waiters(true), closed(false), freeSlot(-1) {}
+
+    // Constructor
+    // Initializes a new empty queue whose woken consumers are passed to
+    // executor, which must resume each handle exactly once
+    explicit AsyncPQ( function<void(coroutine_handle<>)> executor, bool stable = false )
+      : queue(stable), waiters(true), closed(false), freeSlot(-1), executor(std::move(executor)) {}
+
+    AsyncPQ( const AsyncPQ & ) = delete;
+    AsyncPQ & operator=( const AsyncPQ & ) = delete;
+
+    // Awaitable that removes and returns a task ID with minimum priority;
+    // among suspended consumers, smaller waiterPriority is served first
+    PopAwaiter pop( int waiterPriority = 0 ) {
+      return PopAwaiter(*this, waiterPriority);
+    }
+
+    // Insert ID x with priority p, waking a waiting consumer if any
+    void insert( const ID & x, P p ) {
+      vector<coroutine_handle<>> woken;
+      {
+        lock_guard<mutex> lock(m);
+        queue.insert(x, p);
+        handOff(woken);
+      }
+      resumeAll(woken);
+    }
+
+    // Queue tasks[i] with priority priorities[i] for every i (IDs already
+    // queued are reprioritized); waiters are woken once, after all are queued
+    void insertBatch( const vector<ID> & tasks, const vector<P> & priorities ) {
+      vector<coroutine_handle<>> woken;
+      {
+        lock_guard<mutex> lock(m);
+        for (size_t i = 0; i < tasks.size(); i++) {
+          queue.updatePriority(tasks[i], priorities[i]);
+        }
+        handOff(woken);
+      }
+      resumeAll(woken);
+    }
+
+    // Update the priority of ID x to p
+    //    Inserts x with p if not in the queue
+    void updatePriority( const ID & x, P p ) {
+      vector<coroutine_handle<>> woken;
+      {
+        lock_guard<mutex> lock(m);
+        queue.updatePriority(x, p);
+        handOff(woken);
+      }
+      resumeAll(woken);
+    }
+
+    // Pop a task ID with minimum priority into out without waiting
+    //    Returns false if the queue is empty
+    bool tryPop( ID & out ) {
+      lock_guard<mutex> lock(m);
+      if (queue.isEmpty()) {
+        return false;
+      }
+      out = queue.deleteMin();
+      return true;
+    }
+
+    // Remove ID x; return false if x was not queued
+    bool remove( const ID & x ) {
+      lock_guard<mutex> lock(m);
+      if (!queue.contains(x)) {
+        return false;
+      }
+      queue.remove(x);
+      return true;
+    }
+
+    // Resume every waiting consumer; their pops, and any later pop on an
+    // empty queue, throw UnderflowException
+    void shutdown() {
+      vector<coroutine_handle<>> woken;
+      {
+        lock_guard<mutex> lock(m);
+        closed = true;
+        while (!waiters.isEmpty()) {
+          PopAwaiter *w = release(waiters.deleteMin());
+          woken.push_back(w->handle);
+        }
+      }
+      resumeAll(woken);
+    }
+
+    bool isEmpty() const {
+      lock_guard<mutex> lock(m);
+      return queue.isEmpty();
+    }
+
+    int size() const {
+      lock_guard<mutex> lock(m);
+      return queue.size();
+    }
+
+    int waiting() const {
+      lock_guard<mutex> lock(m);
+      return waiters.size();
+    }
+
+    class PopAwaiter {
+
+      public:
+
+        PopAwaiter( AsyncPQ & q, int priority ) : owner(q), waiterPriority(priority), served(false) {}
+
+        // Take a task at once if one is queued and no consumer is waiting
+        bool await_ready() {
+          lock_guard<mutex> lock(owner.m);
+          return takeNow();
+        }
+
+        // Check again under the lock, then queue up as a waiter
+        bool await_suspend( coroutine_handle<> h ) {
+          lock_guard<mutex> lock(owner.m);
+          if (takeNow() || owner.closed) {
+            return false;
+          }
+          handle = h;
+          owner.waiters.insert(owner.attach(this), waiterPriority);
+          return true;
+        }
+
+        ID await_resume() {
+          if (!served) {
+            throw UnderflowException{ };
+          }
+          return value;
+        }
+
+      private:
+
+        friend class AsyncPQ;
+
+        AsyncPQ & owner;
+        int waiterPriority;
+        bool served;
+        ID value;
+        coroutine_handle<> handle;
+
+        bool takeNow() {
+          if (owner.queue.isEmpty() || !owner.waiters.isEmpty()) {
+            return false;
+          }
+          value = owner.queue.deleteMin();
+          served = true;
+          return true;
+        }
+    };
+
+  private:
+
+    PQ<ID, P> queue;
+    PQ<int> waiters;               // slot of each suspended consumer, by waiter priority
+    vector<PopAwaiter *> slots;    // awaiter of each slot; free slots chain through freeList
+    vector<int> freeList;
+    bool closed;
+    int freeSlot;
+    function<void(coroutine_handle<>)> executor;   // empty: resume on the waking thread
+    mutable mutex m;
+
+    int attach( PopAwaiter *w ) {
+      int s;
+      if (freeSlot >= 0) {
+        s = freeSlot;
+        freeSlot = freeList[s];
+        slots[s] = w;
+      }
+      else {
+        s = slots.size();
+        slots.push_back(w);
+        freeList.push_back(-1);
+      }
+      return s;
+    }
+
+    PopAwaiter * release( int s ) {
+      PopAwaiter *w = slots[s];
+      freeList[s] = freeSlot;
+      freeSlot = s;
+      return w;
+    }
+
+    // With the lock held, give queued tasks to waiting consumers in waiter
+    // order and collect their handles for resumption
+    void handOff( vector<coroutine_handle<>> & woken ) {
+      while (!waiters.isEmpty() && !queue.isEmpty()) {
+        PopAwaiter *w = release(waiters.deleteMin());
+        w->value = queue.deleteMin();
+        w->served = true;
+        woken.push_back(w->handle);
+      }
+    }
+
+    void resumeAll( vector<coroutine_handle<>> & woken ) {
+      for (size_t i = 0; i < woken.size(); i++) {
+        if (executor) {
+          executor(woken[i]);
+        }
+        else {
+          woken[i].resume();
+        }
+      }
+    }
+};
+#endif
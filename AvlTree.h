@@ -3,8 +3,10 @@
 
 #include "dsexceptions.h"
 #include "PQ.h"
+#include "TaskPool.h"
 #include <algorithm>
 #include <iostream> 
+#include <vector>
 using namespace std;
 
 // AvlTree class
@@ -26,7 +28,9 @@ using namespace std;
 template <typename ID>
 class AvlTree
 {
-    template <class AVLTree>friend class PQ;
+    template <typename, typename, typename>friend class PQ;
+
+    struct AvlNode;
     
   public:
 
@@ -156,11 +160,11 @@ class AvlTree
 
     /**
      * Insert x into the tree; duplicates are ignored.
+     * Return the node holding x.
      */
-    void* insert( const ID & x, int index )
+    AvlNode * insert( const ID & x, int index )
     {
-        void* ptr = insert( x, index, root );
-        return ptr;
+        return insert( x, index, root );
     }
      
     /**
@@ -194,6 +198,33 @@ class AvlTree
 
     AvlNode *root;
 
+    // PQ reaches each ID's heap index through a handle to its node
+    typedef AvlNode * Handle;
+
+    int & slotOf( AvlNode *h ) { return h->index; }
+
+    const ID & idOf( AvlNode *h ) const { return h->id_num; }
+
+    /**
+     * Call fn on the handle of every node, in sorted order. Used by PQ.
+     */
+    template <typename F>
+    void forEach( F fn )
+    {
+        forEach( root, fn );
+    }
+
+    template <typename F>
+    void forEach( AvlNode *t, F & fn )
+    {
+        if( t != nullptr )
+        {
+            forEach( t->left, fn );
+            fn( t );
+            forEach( t->right, fn );
+        }
+    }
+
     
     /**
      * Internal method to insert into a subtree.
@@ -201,9 +232,9 @@ class AvlTree
      * t is the node that roots the subtree.
      * Set the new root of the subtree.
      */
-    void* insert( const ID & x, int index, AvlNode * & t )
+    AvlNode * insert( const ID & x, int index, AvlNode * & t )
     {
-        void* r;
+        AvlNode *r;
         if( t == nullptr ) {
             t = new AvlNode{ x, index, nullptr, nullptr };
             r = t;
@@ -213,6 +244,8 @@ class AvlTree
             r = insert( x, index, t->left );
         else if( t->id_num < x )
             r = insert( x, index, t->right );
+        else
+            r = t;
         
         balance( t );
         return r;
@@ -247,8 +280,14 @@ class AvlTree
             remove( x, t->right );
         else if( t->left != nullptr && t->right != nullptr ) // Two children
         {
-            t->id_num = findMin( t->right )->id_num;
-            remove( t->id_num, t->right );
+            // Splice the successor node into t's place instead of copying its
+            // ID, so the nodes a PQ holds back-links to are never freed early.
+            AvlNode *oldNode = t;
+            AvlNode *successor = detachMin( t->right );
+            successor->left = oldNode->left;
+            successor->right = oldNode->right;
+            t = successor;
+            delete oldNode;
         }
         else
         {
@@ -260,6 +299,255 @@ class AvlTree
         balance( t );
     }
     
+    /**
+     * Internal method to unlink the smallest node of subtree t.
+     * The node is returned, not deleted; t is rebalanced on the way up.
+     */
+    AvlNode * detachMin( AvlNode * & t )
+    {
+        if( t->left == nullptr )
+        {
+            AvlNode *minNode = t;
+            t = t->right;
+            return minNode;
+        }
+        AvlNode *minNode = detachMin( t->left );
+        balance( t );
+        return minNode;
+    }
+
+    /**
+     * Move every node of rhs into this tree, leaving rhs empty.
+     * If the key ranges are disjoint the trees are joined in O(log n);
+     * otherwise both are flattened and rebuilt balanced in linear time.
+     * Where both trees hold an ID, rhs's node is kept; this tree's node
+     * is deleted and its index appended to displaced. Used by PQ.
+     */
+    void merge( AvlTree && rhs, vector<int> & displaced )
+    {
+        if( rhs.root == nullptr )
+            return;
+        if( root == nullptr )
+        {
+            root = rhs.root;
+            rhs.root = nullptr;
+            return;
+        }
+
+        if( findMax( root )->id_num < findMin( rhs.root )->id_num )
+        {
+            AvlNode *middle = detachMin( rhs.root );
+            root = join( root, middle, rhs.root );
+        }
+        else if( findMax( rhs.root )->id_num < findMin( root )->id_num )
+        {
+            AvlNode *middle = detachMin( root );
+            root = join( rhs.root, middle, root );
+        }
+        else
+        {
+            vector<AvlNode *> lhsNodes, rhsNodes, merged;
+            flatten( root, lhsNodes );
+            flatten( rhs.root, rhsNodes );
+            merged.reserve( lhsNodes.size( ) + rhsNodes.size( ) );
+
+            size_t i = 0, j = 0;
+            while( i < lhsNodes.size( ) && j < rhsNodes.size( ) )
+            {
+                if( lhsNodes[ i ]->id_num < rhsNodes[ j ]->id_num )
+                    merged.push_back( lhsNodes[ i++ ] );
+                else if( rhsNodes[ j ]->id_num < lhsNodes[ i ]->id_num )
+                    merged.push_back( rhsNodes[ j++ ] );
+                else
+                {
+                    displaced.push_back( lhsNodes[ i ]->index );
+                    delete lhsNodes[ i++ ];
+                    merged.push_back( rhsNodes[ j++ ] );
+                }
+            }
+            while( i < lhsNodes.size( ) )
+                merged.push_back( lhsNodes[ i++ ] );
+            while( j < rhsNodes.size( ) )
+                merged.push_back( rhsNodes[ j++ ] );
+
+            root = build( merged, 0, merged.size( ) );
+        }
+        rhs.root = nullptr;
+    }
+
+    /**
+     * Move every node with an ID not less than pivot into upper,
+     * which must be empty. Runs in O(log n). Used by PQ.
+     */
+    void split( const ID & pivot, AvlTree & upper )
+    {
+        AvlNode *lower = nullptr;
+        split( root, pivot, lower, upper.root );
+        root = lower;
+    }
+
+    /**
+     * Internal method to join two subtrees around a middle node k,
+     * where every ID in l is less than k's and every ID in r greater.
+     * Return the new root.
+     */
+    AvlNode * join( AvlNode *l, AvlNode *k, AvlNode *r )
+    {
+        if( height( l ) > height( r ) + ALLOWED_IMBALANCE )
+        {
+            l->right = join( l->right, k, r );
+            balance( l );
+            return l;
+        }
+        if( height( r ) > height( l ) + ALLOWED_IMBALANCE )
+        {
+            r->left = join( l, k, r->left );
+            balance( r );
+            return r;
+        }
+        k->left = l;
+        k->right = r;
+        k->height = max( height( l ), height( r ) ) + 1;
+        return k;
+    }
+
+    /**
+     * Internal method to split subtree t into IDs less than pivot (l)
+     * and the rest (r).
+     */
+    void split( AvlNode *t, const ID & pivot, AvlNode * & l, AvlNode * & r )
+    {
+        if( t == nullptr )
+        {
+            l = r = nullptr;
+            return;
+        }
+        AvlNode *left = t->left, *right = t->right;
+        if( t->id_num < pivot )
+        {
+            AvlNode *mid;
+            split( right, pivot, mid, r );
+            l = join( left, t, mid );
+        }
+        else
+        {
+            AvlNode *mid;
+            split( left, pivot, l, mid );
+            r = join( mid, t, right );
+        }
+    }
+
+    /**
+     * Internal method to append the nodes of subtree t in sorted order.
+     */
+    void flatten( AvlNode *t, vector<AvlNode *> & out ) const
+    {
+        if( t != nullptr )
+        {
+            flatten( t->left, out );
+            out.push_back( t );
+            flatten( t->right, out );
+        }
+    }
+
+    /**
+     * Internal method to link sorted nodes[lo, hi) into a balanced subtree.
+     * Return its root.
+     */
+    AvlNode * build( const vector<AvlNode *> & sorted, size_t lo, size_t hi )
+    {
+        if( lo >= hi )
+            return nullptr;
+        size_t mid = lo + ( hi - lo ) / 2;
+        AvlNode *t = sorted[ mid ];
+        t->left = build( sorted, lo, mid );
+        t->right = build( sorted, mid + 1, hi );
+        t->height = max( height( t->left ), height( t->right ) ) + 1;
+        return t;
+    }
+
+    /**
+     * Make this (empty) tree hold ids[i] with index i, for every i, and
+     * store the node of ids[i] in handles[i]. The nodes are allocated and
+     * sorted by ID in parallel, then linked into a balanced tree whose
+     * lower subtrees are built in parallel. Return false, leaving the
+     * tree empty, if two IDs are equal. Used by PQ.
+     */
+    bool bulkLoad( const vector<ID> & ids, vector<AvlNode *> & handles, TaskPool & pool )
+    {
+        long n = ids.size( );
+        handles.resize( n );
+        pool.parallelFor( 0, n, [&ids, &handles]( long lo, long hi ) {
+            for( long i = lo; i < hi; i++ )
+                handles[ i ] = new AvlNode{ ids[ i ], (int) i, nullptr, nullptr };
+        } );
+
+        vector<AvlNode *> nodes = handles;
+        parallelSort( nodes, []( const AvlNode *a, const AvlNode *b ) { return a->id_num < b->id_num; }, pool );
+
+        for( long i = 1; i < n; i++ )
+            if( !( nodes[ i - 1 ]->id_num < nodes[ i ]->id_num ) )
+            {
+                for( long j = 0; j < n; j++ )
+                    delete nodes[ j ];
+                handles.clear( );
+                return false;
+            }
+
+        // link the top levels here and leave one subtree range per job
+        vector<BuildJob> jobs;
+        int depth = 0;
+        while( ( 1 << depth ) < pool.size( ) * 4 )
+            depth++;
+        linkTop( nodes, 0, n, depth, root, jobs );
+        for( size_t j = 0; j < jobs.size( ); j++ )
+        {
+            BuildJob job = jobs[ j ];
+            pool.submit( [this, &nodes, job] {
+                *job.slot = build( nodes, job.lo, job.hi );
+            } );
+        }
+        pool.wait( );
+        return true;
+    }
+
+    struct BuildJob
+    {
+        size_t lo;
+        size_t hi;
+        AvlNode **slot;
+    };
+
+    /**
+     * Internal method to link the top depth levels of the balanced tree
+     * over sorted[lo, hi) into slot, queueing the subtrees below as jobs.
+     * Matches the shape build() produces, so a subtree of k nodes has
+     * height floor(log2(k)) and can be set before its children exist.
+     */
+    void linkTop( const vector<AvlNode *> & sorted, size_t lo, size_t hi, int depth,
+                  AvlNode * & slot, vector<BuildJob> & jobs )
+    {
+        if( lo >= hi )
+        {
+            slot = nullptr;
+            return;
+        }
+        if( depth == 0 )
+        {
+            jobs.push_back( BuildJob{ lo, hi, &slot } );
+            return;
+        }
+        size_t mid = lo + ( hi - lo ) / 2;
+        AvlNode *t = sorted[ mid ];
+        slot = t;
+        linkTop( sorted, lo, mid, depth - 1, t->left, jobs );
+        linkTop( sorted, mid + 1, hi, depth - 1, t->right, jobs );
+        int h = 0;
+        for( size_t k = hi - lo; k > 1; k /= 2 )
+            h++;
+        t->height = h;
+    }
+
     static const int ALLOWED_IMBALANCE = 1;
 
     // Assume t is balanced or within one of being balanced
@@ -0,0 +1,613 @@
+#ifndef BTREE_INDEX_H
+#define BTREE_INDEX_H
+
+#include "dsexceptions.h"
+#include "TaskPool.h"
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// BTreeIndex class
+//
+// An ordered ID index for PQ with the same surface as AvlTree, laid out
+// as a B+-tree of 256-byte, cache-line-aligned nodes. A lookup touches
+// about log_B(n) nodes, each scanned linearly, instead of the ~log2(n)
+// scattered nodes of an AvlTree, which pays off once the index no longer
+// fits in cache. Each ID's heap index lives in a record addressed by a
+// stable integer handle, so leaf splits never invalidate PQ's back-links.
+// Removal frees empty nodes but does not merge underfull ones.
+//
+// Use as PQ<ID, P, BTreeIndex<ID>>.
+//
+// CONSTRUCTION: zero parameter
+//
+// ******************PUBLIC OPERATIONS*********************
+// int insert( x, index )  --> Insert x with heap index index; return its handle
+// void remove( x )        --> Remove x; nothing is done if x is not found
+// int findIndex( x )      --> Return the heap index of x, or -1 if absent
+// bool contains( x )      --> Return true if x is present
+// ID findMin( )           --> Return smallest item
+// ID findMax( )           --> Return largest item
+// bool isEmpty( )         --> Return true if empty; else false
+// int size( )             --> Return the number of items
+// void makeEmpty( )       --> Remove all items
+// void printTree( )       --> Print tree in sorted order
+// ******************ERRORS********************************
+// Throws UnderflowException as warranted
+
+template <typename ID>
+class BTreeIndex {
+
+    template <typename, typename, typename> friend class PQ;
+
+  public:
+
+    BTreeIndex() : root(nullptr), count(0), freeRecord(-1) {}
+
+    BTreeIndex( BTreeIndex && rhs ) : BTreeIndex() {
+      swapWith(rhs);
+    }
+
+    BTreeIndex & operator=( BTreeIndex && rhs ) {
+      swapWith(rhs);
+      return *this;
+    }
+
+    BTreeIndex( const BTreeIndex & ) = delete;
+    BTreeIndex & operator=( const BTreeIndex & ) = delete;
+
+    ~BTreeIndex() {
+      makeEmpty();
+    }
+
+    bool isEmpty() const { return root == nullptr; }
+
+    int size() const { return count; }
+
+    // Find the smallest item; throw UnderflowException if empty
+    const ID & findMin() const {
+      if (isEmpty()) {
+        throw UnderflowException{ };
+      }
+      const Node *t = root;
+      while (!t->leaf) {
+        t = static_cast<const Inner *>(t)->children[0];
+      }
+      return static_cast<const Leaf *>(t)->keys[0];
+    }
+
+    // Find the largest item; throw UnderflowException if empty
+    const ID & findMax() const {
+      if (isEmpty()) {
+        throw UnderflowException{ };
+      }
+      const Node *t = root;
+      while (!t->leaf) {
+        t = static_cast<const Inner *>(t)->children[t->count];
+      }
+      return static_cast<const Leaf *>(t)->keys[t->count - 1];
+    }
+
+    // Returns true if x is found in the tree
+    bool contains( const ID & x ) const {
+      return find(x) >= 0;
+    }
+
+    // Return the heap index stored with x, or -1 if x is not found
+    int findIndex( const ID & x ) const {
+      int h = find(x);
+      return h < 0 ? -1 : records[h].slot;
+    }
+
+    // Insert x with heap index index; duplicates are ignored.
+    // Return the handle of x.
+    int insert( const ID & x, int index ) {
+      if (root == nullptr) {
+        root = new Leaf();
+      }
+      ID sep;
+      int h;
+      Node *right = insert(x, index, root, sep, h);
+      if (right != nullptr) {
+        Inner *top = new Inner();
+        top->count = 1;
+        top->keys[0] = sep;
+        top->children[0] = root;
+        top->children[1] = right;
+        root = top;
+      }
+      return h;
+    }
+
+    // Remove x from the tree. Nothing is done if x is not found.
+    void remove( const ID & x ) {
+      if (root == nullptr) {
+        return;
+      }
+      if (remove(x, root)) {
+        deleteNode(root);
+        root = nullptr;
+        return;
+      }
+      while (!root->leaf && root->count == 0) {
+        Inner *old = static_cast<Inner *>(root);
+        root = old->children[0];
+        delete old;
+      }
+    }
+
+    // Make the tree logically empty
+    void makeEmpty() {
+      freeNodes(root);
+      root = nullptr;
+      count = 0;
+      records.clear();
+      freeRecord = -1;
+    }
+
+    // Print the tree contents in sorted order
+    void printTree() const {
+      if (isEmpty()) {
+        cout << "Empty tree" << endl;
+        return;
+      }
+      const_cast<BTreeIndex *>(this)->forEach([this](int h) {
+        cout << "ID: " << records[h].id << " PQ Index: " << records[h].slot << endl;
+      });
+    }
+
+  private:
+
+    static const int NODE_BYTES = 256;
+    static const int HEADER_BYTES = 8;
+
+    // entries per leaf and separator keys per inner node that fit in NODE_BYTES
+    static constexpr int LEAF_MAX = (NODE_BYTES - HEADER_BYTES) / (sizeof(ID) + sizeof(int)) < 4
+      ? 4 : (NODE_BYTES - HEADER_BYTES) / (sizeof(ID) + sizeof(int));
+    static constexpr int INNER_MAX = (NODE_BYTES - HEADER_BYTES - sizeof(void *)) / (sizeof(ID) + sizeof(void *)) < 4
+      ? 4 : (NODE_BYTES - HEADER_BYTES - sizeof(void *)) / (sizeof(ID) + sizeof(void *));
+
+    struct Node {
+      int count;     // keys held; an inner node has count + 1 children
+      bool leaf;
+    };
+
+    struct alignas(64) Leaf : Node {
+      ID keys[LEAF_MAX];
+      int recs[LEAF_MAX];      // record handle of each key
+      Leaf() : Node{ 0, true } {}
+    };
+
+    // children[i] holds the keys in [keys[i-1], keys[i])
+    struct alignas(64) Inner : Node {
+      ID keys[INNER_MAX];
+      Node *children[INNER_MAX + 1];
+      Inner() : Node{ 0, false } {}
+    };
+
+    // PQ reaches each ID's heap index through the handle of its record
+    struct Record {
+      ID id;
+      int slot;      // heap index; the next free record while on the free list
+    };
+
+    typedef int Handle;
+
+    Node *root;
+    int count;
+    vector<Record> records;
+    int freeRecord;
+
+    int & slotOf( int h ) { return records[h].slot; }
+
+    const ID & idOf( int h ) const { return records[h].id; }
+
+    void swapWith( BTreeIndex & rhs ) {
+      std::swap(root, rhs.root);
+      std::swap(count, rhs.count);
+      records.swap(rhs.records);
+      std::swap(freeRecord, rhs.freeRecord);
+    }
+
+    int allocRecord( const ID & x, int slot ) {
+      count++;
+      if (freeRecord >= 0) {
+        int h = freeRecord;
+        freeRecord = records[h].slot;
+        records[h].id = x;
+        records[h].slot = slot;
+        return h;
+      }
+      records.push_back(Record{ x, slot });
+      return records.size() - 1;
+    }
+
+    void freeRecordAt( int h ) {
+      count--;
+      records[h].slot = freeRecord;
+      freeRecord = h;
+    }
+
+    // Position of the first key in leaf t not less than x
+    static int lowerBound( const Leaf *t, const ID & x ) {
+      int i = 0;
+      while (i < t->count && t->keys[i] < x) {
+        i++;
+      }
+      return i;
+    }
+
+    // Index of the child of inner node t whose range holds x
+    static int childFor( const Inner *t, const ID & x ) {
+      int i = 0;
+      while (i < t->count && !(x < t->keys[i])) {
+        i++;
+      }
+      return i;
+    }
+
+    // Record handle of x, or -1
+    int find( const ID & x ) const {
+      const Node *t = root;
+      if (t == nullptr) {
+        return -1;
+      }
+      while (!t->leaf) {
+        const Inner *in = static_cast<const Inner *>(t);
+        t = in->children[childFor(in, x)];
+      }
+      const Leaf *l = static_cast<const Leaf *>(t);
+      int i = lowerBound(l, x);
+      if (i < l->count && !(x < l->keys[i])) {
+        return l->recs[i];
+      }
+      return -1;
+    }
+
+    /**
+     * Internal method to insert x into subtree t, storing x's handle in h.
+     * If t splits, return the new right sibling and set sep to its
+     * smallest key; otherwise return nullptr.
+     */
+    Node * insert( const ID & x, int index, Node *t, ID & sep, int & h ) {
+      if (t->leaf) {
+        Leaf *l = static_cast<Leaf *>(t);
+        int pos = lowerBound(l, x);
+        if (pos < l->count && !(x < l->keys[pos])) {
+          h = l->recs[pos];
+          return nullptr;
+        }
+        h = allocRecord(x, index);
+        if (l->count < LEAF_MAX) {
+          for (int i = l->count; i > pos; i--) {
+            l->keys[i] = l->keys[i - 1];
+            l->recs[i] = l->recs[i - 1];
+          }
+          l->keys[pos] = x;
+          l->recs[pos] = h;
+          l->count++;
+          return nullptr;
+        }
+
+        // full: the upper half moves to a new leaf
+        Leaf *r = new Leaf();
+        int half = LEAF_MAX / 2;
+        Leaf *target = l;
+        for (int i = half; i < LEAF_MAX; i++) {
+          r->keys[i - half] = l->keys[i];
+          r->recs[i - half] = l->recs[i];
+        }
+        r->count = LEAF_MAX - half;
+        l->count = half;
+        if (pos > half) {
+          target = r;
+          pos -= half;
+        }
+        for (int i = target->count; i > pos; i--) {
+          target->keys[i] = target->keys[i - 1];
+          target->recs[i] = target->recs[i - 1];
+        }
+        target->keys[pos] = x;
+        target->recs[pos] = h;
+        target->count++;
+        sep = r->keys[0];
+        return r;
+      }
+
+      Inner *in = static_cast<Inner *>(t);
+      int c = childFor(in, x);
+      ID childSep;
+      Node *split = insert(x, index, in->children[c], childSep, h);
+      if (split == nullptr) {
+        return nullptr;
+      }
+      if (in->count < INNER_MAX) {
+        for (int i = in->count; i > c; i--) {
+          in->keys[i] = in->keys[i - 1];
+          in->children[i + 1] = in->children[i];
+        }
+        in->keys[c] = childSep;
+        in->children[c + 1] = split;
+        in->count++;
+        return nullptr;
+      }
+
+      // full: lay out the INNER_MAX + 1 keys in order, keep the lower half,
+      // push the middle key up and move the rest to a new node
+      ID keys[INNER_MAX + 1];
+      Node *children[INNER_MAX + 2];
+      for (int i = 0, j = 0; i <= INNER_MAX; i++) {
+        if (i == c) {
+          keys[i] = childSep;
+        }
+        else {
+          keys[i] = in->keys[j++];
+        }
+      }
+      for (int i = 0, j = 0; i <= INNER_MAX + 1; i++) {
+        if (i == c + 1) {
+          children[i] = split;
+        }
+        else {
+          children[i] = in->children[j++];
+        }
+      }
+      int mid = (INNER_MAX + 1) / 2;
+      Inner *r = new Inner();
+      in->count = mid;
+      for (int i = 0; i < mid; i++) {
+        in->keys[i] = keys[i];
+        in->children[i] = children[i];
+      }
+      in->children[mid] = children[mid];
+      r->count = INNER_MAX - mid;
+      for (int i = 0; i < r->count; i++) {
+        r->keys[i] = keys[mid + 1 + i];
+        r->children[i] = children[mid + 1 + i];
+      }
+      r->children[r->count] = children[INNER_MAX + 1];
+      sep = keys[mid];
+      return r;
+    }
+
+    /**
+     * Internal method to remove x from subtree t.
+     * Return true if t is left with no keys (leaf) or no children (inner);
+     * the caller then deletes the node itself.
+     */
+    bool remove( const ID & x, Node *t ) {
+      if (t->leaf) {
+        Leaf *l = static_cast<Leaf *>(t);
+        int pos = lowerBound(l, x);
+        if (pos == l->count || x < l->keys[pos]) {
+          return false;
+        }
+        freeRecordAt(l->recs[pos]);
+        l->count--;
+        for (int i = pos; i < l->count; i++) {
+          l->keys[i] = l->keys[i + 1];
+          l->recs[i] = l->recs[i + 1];
+        }
+        return l->count == 0;
+      }
+
+      Inner *in = static_cast<Inner *>(t);
+      int c = childFor(in, x);
+      if (!remove(x, in->children[c])) {
+        return false;
+      }
+      deleteNode(in->children[c]);
+      if (in->count == 0) {
+        return true;
+      }
+      // drop child c and the separator on one side of it
+      int k = c > 0 ? c - 1 : 0;
+      for (int i = k; i < in->count - 1; i++) {
+        in->keys[i] = in->keys[i + 1];
+      }
+      for (int i = c; i < in->count; i++) {
+        in->children[i] = in->children[i + 1];
+      }
+      in->count--;
+      return false;
+    }
+
+    // Internal method to free node t alone, whose children are already gone
+    static void deleteNode( Node *t ) {
+      if (t->leaf) {
+        delete static_cast<Leaf *>(t);
+      }
+      else {
+        delete static_cast<Inner *>(t);
+      }
+    }
+
+    // Internal method to free the nodes (not the records) of subtree t
+    void freeNodes( Node *t ) {
+      if (t == nullptr) {
+        return;
+      }
+      if (t->leaf) {
+        delete static_cast<Leaf *>(t);
+        return;
+      }
+      Inner *in = static_cast<Inner *>(t);
+      for (int i = 0; i <= in->count; i++) {
+        freeNodes(in->children[i]);
+      }
+      delete in;
+    }
+
+    /**
+     * Call fn on the handle of every item, in sorted order. Used by PQ.
+     */
+    template <typename F>
+    void forEach( F fn ) {
+      forEach(root, fn);
+    }
+
+    template <typename F>
+    void forEach( Node *t, F & fn ) {
+      if (t == nullptr) {
+        return;
+      }
+      if (t->leaf) {
+        Leaf *l = static_cast<Leaf *>(t);
+        for (int i = 0; i < l->count; i++) {
+          fn(l->recs[i]);
+        }
+        return;
+      }
+      Inner *in = static_cast<Inner *>(t);
+      for (int i = 0; i <= in->count; i++) {
+        forEach(in->children[i], fn);
+      }
+    }
+
+    // Append the record handles of the tree in sorted order
+    void flatten( vector<int> & out ) {
+      forEach([&out](int h) { out.push_back(h); });
+    }
+
+    /**
+     * Move every item of rhs into this tree, leaving rhs empty, in linear
+     * time. Where both trees hold an ID, rhs's item is kept; this tree's
+     * record is freed and its heap index appended to displaced. Used by PQ.
+     */
+    void merge( BTreeIndex && rhs, vector<int> & displaced ) {
+      vector<int> lhsRecs, rhsRecs, merged;
+      flatten(lhsRecs);
+      rhs.flatten(rhsRecs);
+      merged.reserve(lhsRecs.size() + rhsRecs.size());
+
+      size_t i = 0, j = 0;
+      while (i < lhsRecs.size() || j < rhsRecs.size()) {
+        if (j == rhsRecs.size()
+            || (i < lhsRecs.size() && records[lhsRecs[i]].id < rhs.records[rhsRecs[j]].id)) {
+          merged.push_back(lhsRecs[i++]);
+          continue;
+        }
+        const Record & moved = rhs.records[rhsRecs[j++]];
+        if (i < lhsRecs.size() && !(moved.id < records[lhsRecs[i]].id)) {
+          displaced.push_back(records[lhsRecs[i]].slot);
+          freeRecordAt(lhsRecs[i++]);
+        }
+        merged.push_back(allocRecord(moved.id, moved.slot));
+      }
+
+      freeNodes(root);
+      root = build(merged);
+      rhs.makeEmpty();
+    }
+
+    /**
+     * Move every item with an ID not less than pivot into upper, which
+     * must be empty, in linear time. Used by PQ.
+     */
+    void split( const ID & pivot, BTreeIndex & upper ) {
+      vector<int> all, lower, moved;
+      flatten(all);
+      for (size_t i = 0; i < all.size(); i++) {
+        const Record & r = records[all[i]];
+        if (r.id < pivot) {
+          lower.push_back(all[i]);
+        }
+        else {
+          moved.push_back(upper.allocRecord(r.id, r.slot));
+          freeRecordAt(all[i]);
+        }
+      }
+      freeNodes(root);
+      root = build(lower);
+      upper.root = upper.build(moved);
+    }
+
+    /**
+     * Make this (empty) tree hold ids[i] with index i, for every i, and
+     * store the handle of ids[i] in handles[i]. Records are filled and
+     * sorted by ID in parallel, and the leaves are packed in parallel.
+     * Return false, leaving the tree empty, if two IDs are equal. Used by PQ.
+     */
+    bool bulkLoad( const vector<ID> & ids, vector<int> & handles, TaskPool & pool ) {
+      long n = ids.size();
+      records.resize(n);
+      handles.resize(n);
+      pool.parallelFor(0, n, [this, &ids, &handles](long lo, long hi) {
+        for (long i = lo; i < hi; i++) {
+          records[i].id = ids[i];
+          records[i].slot = i;
+          handles[i] = i;
+        }
+      });
+
+      vector<int> sorted = handles;
+      parallelSort(sorted, [this](int a, int b) { return records[a].id < records[b].id; }, pool);
+      for (long i = 1; i < n; i++) {
+        if (!(records[sorted[i - 1]].id < records[sorted[i]].id)) {
+          records.clear();
+          handles.clear();
+          return false;
+        }
+      }
+      count = n;
+      root = build(sorted, &pool);
+      return true;
+    }
+
+    /**
+     * Internal method to build a tree over sorted record handles, packing
+     * leaves full and linking the inner levels bottom-up. Return its root.
+     */
+    Node * build( const vector<int> & sorted, TaskPool *pool = nullptr ) {
+      long n = sorted.size();
+      if (n == 0) {
+        return nullptr;
+      }
+      long leaves = (n + LEAF_MAX - 1) / LEAF_MAX;
+      vector<Node *> level(leaves);
+      vector<ID> mins(leaves);
+      auto pack = [&](long lo, long hi) {
+        for (long b = lo; b < hi; b++) {
+          long from = n * b / leaves, to = n * (b + 1) / leaves;
+          Leaf *l = new Leaf();
+          for (long i = from; i < to; i++) {
+            l->keys[i - from] = records[sorted[i]].id;
+            l->recs[i - from] = sorted[i];
+          }
+          l->count = to - from;
+          level[b] = l;
+          mins[b] = l->keys[0];
+        }
+      };
+      if (pool != nullptr) {
+        pool->parallelFor(0, leaves, pack);
+      }
+      else {
+        pack(0, leaves);
+      }
+
+      while (level.size() > 1) {
+        long k = level.size();
+        long groups = (k + INNER_MAX) / (INNER_MAX + 1);
+        vector<Node *> up(groups);
+        vector<ID> upMins(groups);
+        for (long g = 0; g < groups; g++) {
+          long from = k * g / groups, to = k * (g + 1) / groups;
+          Inner *in = new Inner();
+          in->count = to - from - 1;
+          for (long i = from; i < to; i++) {
+            in->children[i - from] = level[i];
+            if (i > from) {
+              in->keys[i - from - 1] = mins[i];
+            }
+          }
+          up[g] = in;
+          upMins[g] = mins[from];
+        }
+        level.swap(up);
+        mins.swap(upMins);
+      }
+      return level[0];
+    }
+};
+#endif
@@ -0,0 +1,209 @@
+#ifndef DENSE_INDEX_H
+#define DENSE_INDEX_H
+
+#include "dsexceptions.h"
+#include "TaskPool.h"
+#include <algorithm>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// IDUniverse trait
+//
+// Declares that the IDs of an integral type are dense in [0, size).
+// PQ<ID> picks DenseIndex<ID> as its index for such types. Specialize
+// it before the first use of PQ<ID>, e.g.
+//   template <> struct IDUniverse<uint32_t> { static constexpr long long size = 1 << 20; };
+template <typename ID>
+struct IDUniverse {
+    static constexpr long long size = 0;    // 0: no universe declared
+};
+
+// DenseIndex class
+//
+// An ID index for PQ when task IDs are small non-negative integers. The
+// heap index of ID x is stored directly at position x of a flat table
+// (-1 if x is absent), so lookups, inserts and removals are one array
+// access and the whole index costs 4 bytes per table slot, with no
+// per-ID allocation. The table is sized to IDUniverse<ID>::size if
+// declared (so constructing a DenseIndex costs O(universe)), and otherwise
+// grows to the largest ID inserted. The table cannot list its IDs without
+// a scan, so PQ walks its own heap, which holds every ID, to merge, split
+// or empty a queue. The handle PQ keeps for an ID is the ID itself.
+//
+// Use as PQ<ID, P, DenseIndex<ID>>, or declare IDUniverse<ID>.
+//
+// CONSTRUCTION: zero parameter
+//
+// ******************PUBLIC OPERATIONS*********************
+// ID insert( x, index )  --> Insert x with heap index index; return its handle
+// void remove( x )       --> Remove x; nothing is done if x is not found
+// int findIndex( x )     --> Return the heap index of x, or -1 if absent
+// bool contains( x )     --> Return true if x is present
+// ID findMin( )          --> Return smallest item, in O(table size)
+// ID findMax( )          --> Return largest item, in O(table size)
+// bool isEmpty( )        --> Return true if empty; else false
+// int size( )            --> Return the number of items
+// void makeEmpty( )      --> Remove all items, in O(table size)
+// void printTree( )      --> Print items in sorted order
+// ******************ERRORS********************************
+// Throws UnderflowException as warranted
+// Throws IllegalArgumentException on insert of a negative ID, or of one
+// outside a declared universe
+
+template <typename ID>
+class DenseIndex {
+
+    static_assert(is_integral<ID>::value, "DenseIndex needs an integral ID type");
+
+    template <typename, typename, typename> friend class PQ;
+
+  public:
+
+    DenseIndex() : count(0) {
+      pos.assign(IDUniverse<ID>::size, -1);
+    }
+
+    // The moved-from index is left with an empty table, which regrows on insert
+    DenseIndex( DenseIndex && rhs ) : pos(std::move(rhs.pos)), count(rhs.count) {
+      rhs.pos.clear();
+      rhs.count = 0;
+    }
+
+    DenseIndex & operator=( DenseIndex && rhs ) {
+      pos = std::move(rhs.pos);
+      count = rhs.count;
+      rhs.pos.clear();
+      rhs.count = 0;
+      return *this;
+    }
+
+    DenseIndex( const DenseIndex & ) = delete;
+    DenseIndex & operator=( const DenseIndex & ) = delete;
+
+    bool isEmpty() const { return count == 0; }
+
+    int size() const { return count; }
+
+    // Find the smallest item; throw UnderflowException if empty
+    ID findMin() const {
+      if (isEmpty()) {
+        throw UnderflowException{ };
+      }
+      size_t x = 0;
+      while (pos[x] < 0) {
+        x++;
+      }
+      return x;
+    }
+
+    // Find the largest item; throw UnderflowException if empty
+    ID findMax() const {
+      if (isEmpty()) {
+        throw UnderflowException{ };
+      }
+      size_t x = pos.size() - 1;
+      while (pos[x] < 0) {
+        x--;
+      }
+      return x;
+    }
+
+    // Returns true if x is present
+    bool contains( const ID & x ) const {
+      return findIndex(x) >= 0;
+    }
+
+    // Return the heap index stored with x, or -1 if x is not found
+    int findIndex( const ID & x ) const {
+      if (x < 0 || (size_t) x >= pos.size()) {
+        return -1;
+      }
+      return pos[x];
+    }
+
+    // Insert x with heap index index; duplicates are ignored.
+    // Return the handle of x, which is x.
+    ID insert( const ID & x, int index ) {
+      reserveFor(x);
+      if (pos[x] < 0) {
+        pos[x] = index;
+        count++;
+      }
+      return x;
+    }
+
+    // Remove x. Nothing is done if x is not found.
+    void remove( const ID & x ) {
+      if (findIndex(x) >= 0) {
+        pos[x] = -1;
+        count--;
+      }
+    }
+
+    // Make the index logically empty; the table keeps its size
+    void makeEmpty() {
+      if (count > 0) {
+        fill(pos.begin(), pos.end(), -1);
+        count = 0;
+      }
+    }
+
+    // Print the items in sorted order
+    void printTree() const {
+      if (isEmpty()) {
+        cout << "Empty tree" << endl;
+        return;
+      }
+      for (size_t x = 0; x < pos.size(); x++) {
+        if (pos[x] >= 0) {
+          cout << "ID: " << x << " PQ Index: " << pos[x] << endl;
+        }
+      }
+    }
+
+  private:
+
+    typedef ID Handle;
+
+    vector<int> pos;     // heap index of each ID, -1 if absent
+    int count;
+
+    int & slotOf( const ID & h ) { return pos[h]; }
+
+    const ID & idOf( const ID & h ) const { return h; }
+
+    // Grow the table to hold x; throw IllegalArgumentException if x can never fit
+    void reserveFor( const ID & x ) {
+      if (x < 0 || (IDUniverse<ID>::size > 0 && (long long) x >= IDUniverse<ID>::size)) {
+        throw IllegalArgumentException{ };
+      }
+      if ((size_t) x >= pos.size()) {
+        pos.resize(max((size_t) x + 1, pos.size() * 2), -1);
+      }
+    }
+
+    /**
+     * Make this (empty) index hold ids[i] with index i, for every i, and
+     * store the handle of ids[i] in handles[i]. Each ID is one table
+     * write, so the load runs on the calling thread. Return false, leaving
+     * the index empty, if two IDs are equal. Used by PQ.
+     */
+    bool bulkLoad( const vector<ID> & ids, vector<ID> & handles, TaskPool & ) {
+      int n = ids.size();
+      for (int i = 0; i < n; i++) {
+        reserveFor(ids[i]);
+        if (pos[ids[i]] >= 0) {
+          for (int j = 0; j < i; j++) {
+            pos[ids[j]] = -1;
+          }
+          return false;
+        }
+        pos[ids[i]] = i;
+      }
+      count = n;
+      handles = ids;
+      return true;
+    }
+};
+#endif
@@ -0,0 +1,648 @@
+#ifndef EXTERNAL_PQ_H
+#define EXTERNAL_PQ_H
+
+#include "dsexceptions.h"
+#include "PQ.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <unistd.h>
+using namespace std;
+
+// Create a new run file named dir/prefix plus a unique suffix, open it for
+// update and store its name in path. mkstemp creates the file exclusively,
+// so queues sharing dir, in this process or another, never reuse each
+// other's names; throws IOException if the file cannot be created
+inline FILE * createRunFile( const string & dir, const char * prefix, string & path ) {
+    string name = dir + "/" + prefix + "XXXXXX";
+    vector<char> templ(name.begin(), name.end());
+    templ.push_back('\0');
+    int fd = mkstemp(templ.data());
+    if (fd < 0) {
+        throw IOException{ };
+    }
+    path = templ.data();
+    FILE * file = fdopen(fd, "w+b");
+    if (file == nullptr) {
+        close(fd);
+        std::remove(path.c_str());
+        throw IOException{ };
+    }
+    return file;
+}
+
+// DiskIndex class
+//
+// An ID -> version map for ExternalPQ, kept as a small in-memory table
+// plus sorted run files on disk (newest run wins). Version 0 is a
+// tombstone: the ID is not in the queue. Runs are merged by size ratio:
+// a new run is merged into the run before it until that one is at least
+// RATIO times larger, so run sizes grow geometrically, there are
+// O(log n) runs, and each entry is rewritten O(log n) times.
+//
+// CONSTRUCTION: directory for run files, number of IDs buffered in memory
+//
+// ******************PUBLIC OPERATIONS*********************
+// void put( x, v )          --> Record version v for ID x (0 to delete x)
+// uint64_t lookup( x )      --> Return the latest version of x, or 0 if absent
+// int runCount( )           --> Return the number of run files
+// ******************ERRORS********************************
+// Throws IOException if a run file cannot be created or read
+
+template <typename ID>
+class DiskIndex {
+
+  public:
+
+    DiskIndex( const string & dir, size_t memLimit )
+      : dir(dir), memLimit(memLimit) {}
+
+    ~DiskIndex() {
+      for (size_t r = 0; r < runs.size(); r++) {
+        closeRun(runs[r]);
+      }
+    }
+
+    DiskIndex( const DiskIndex & ) = delete;
+    DiskIndex & operator=( const DiskIndex & ) = delete;
+
+    // Record version v for ID x; flushes the memory table when it is full
+    void put( const ID & x, uint64_t v ) {
+      mem[x] = v;
+      if (mem.size() >= memLimit) {
+        flush();
+      }
+    }
+
+    // Return the latest version of x, or 0 if x is absent or deleted
+    //    Costs one block read per run that is searched
+    uint64_t lookup( const ID & x ) {
+      typename map<ID, uint64_t>::iterator it = mem.find(x);
+      if (it != mem.end()) {
+        return it->second;
+      }
+      for (int r = runs.size() - 1; r >= 0; r--) {
+        uint64_t v;
+        if (lookup(runs[r], x, v)) {
+          return v;
+        }
+      }
+      return 0;
+    }
+
+    int runCount() const { return runs.size(); }
+
+  private:
+
+    // Entries per block; the first ID of every block is kept in memory
+    static constexpr size_t BLOCK = 512;
+    // Size ratio kept between neighbouring runs
+    static constexpr size_t RATIO = 4;
+
+    struct Entry {
+      ID id;
+      uint64_t version;
+    };
+
+    struct Run {
+      FILE *file;
+      string path;
+      size_t count;
+      vector<ID> fences;   // first ID of each block
+    };
+
+    string dir;
+    size_t memLimit;
+    map<ID, uint64_t> mem;
+    vector<Run> runs;
+    vector<Entry> block;   // scratch buffer for lookups
+
+    void flush() {
+      Run run = createRun();
+      vector<Entry> out;
+      out.reserve(BLOCK);
+      for (typename map<ID, uint64_t>::iterator it = mem.begin(); it != mem.end(); ++it) {
+        pushEntry(out, it->first, it->second);
+        if (out.size() == BLOCK) {
+          appendBlock(run, out);
+        }
+      }
+      appendBlock(run, out);
+      mem.clear();
+      runs.push_back(run);
+
+      size_t first = runs.size() - 1;
+      while (first > 0 && runs[first - 1].count < RATIO * mergedCount(first)) {
+        first--;
+      }
+      if (first + 1 < runs.size()) {
+        compact(first);
+      }
+    }
+
+    // Entries in runs[first..] together
+    size_t mergedCount( size_t first ) const {
+      size_t total = 0;
+      for (size_t r = first; r < runs.size(); r++) {
+        total += runs[r].count;
+      }
+      return total;
+    }
+
+    // Merge runs[first..] into one run, newest version winning. Tombstones
+    // are dropped when the oldest run takes part, as nothing older remains
+    // for them to shadow.
+    void compact( size_t first ) {
+      int k = runs.size() - first;
+      vector<vector<Entry>> buffers(k);
+      vector<size_t> pos(k, 0), nextBlock(k, 0);
+      for (int r = 0; r < k; r++) {
+        refill(runs[first + r], nextBlock[r], buffers[r]);
+      }
+
+      Run merged = createRun();
+      vector<Entry> out;
+      out.reserve(BLOCK);
+      while (true) {
+        int newest = -1;
+        for (int r = 0; r < k; r++) {
+          if (pos[r] < buffers[r].size()
+              && (newest < 0 || !(buffers[newest][pos[newest]].id < buffers[r][pos[r]].id))) {
+            newest = r;
+          }
+        }
+        if (newest < 0) {
+          break;
+        }
+        Entry e = buffers[newest][pos[newest]];
+        for (int r = 0; r < k; r++) {
+          if (pos[r] < buffers[r].size()
+              && !(buffers[r][pos[r]].id < e.id) && !(e.id < buffers[r][pos[r]].id)) {
+            if (++pos[r] == buffers[r].size()) {
+              refill(runs[first + r], nextBlock[r], buffers[r]);
+              pos[r] = 0;
+            }
+          }
+        }
+        if (e.version != 0 || first > 0) {
+          pushEntry(out, e.id, e.version);
+          if (out.size() == BLOCK) {
+            appendBlock(merged, out);
+          }
+        }
+      }
+      appendBlock(merged, out);
+
+      for (size_t r = first; r < runs.size(); r++) {
+        closeRun(runs[r]);
+      }
+      runs.resize(first);
+      runs.push_back(merged);
+    }
+
+    // Append an entry whose padding bytes are zeroed, as it goes to disk raw
+    static void pushEntry( vector<Entry> & out, const ID & x, uint64_t v ) {
+      out.emplace_back();
+      out.back().id = x;
+      out.back().version = v;
+    }
+
+    bool lookup( Run & run, const ID & x, uint64_t & v ) {
+      if (run.count == 0 || x < run.fences[0]) {
+        return false;
+      }
+      size_t b = upper_bound(run.fences.begin(), run.fences.end(), x) - run.fences.begin() - 1;
+      refill(run, b, block);
+      size_t lo = 0, hi = block.size();
+      while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (block[mid].id < x) {
+          lo = mid + 1;
+        }
+        else {
+          hi = mid;
+        }
+      }
+      if (lo < block.size() && !(x < block[lo].id)) {
+        v = block[lo].version;
+        return true;
+      }
+      return false;
+    }
+
+    Run createRun() {
+      Run run;
+      run.file = createRunFile(dir, "pq-index.", run.path);
+      run.count = 0;
+      return run;
+    }
+
+    void appendBlock( Run & run, vector<Entry> & out ) {
+      if (out.empty()) {
+        return;
+      }
+      if (fwrite(out.data(), sizeof(Entry), out.size(), run.file) != out.size()) {
+        throw IOException{ };
+      }
+      run.fences.push_back(out[0].id);
+      run.count += out.size();
+      out.clear();
+    }
+
+    // Read block b of run into buffer, leaving it empty past the end; advances b
+    void refill( Run & run, size_t & b, vector<Entry> & buffer ) {
+      size_t first = b * BLOCK;
+      size_t n = first < run.count ? min(BLOCK, run.count - first) : 0;
+      buffer.resize(n);
+      if (n > 0) {
+        if (fseek(run.file, (long) (first * sizeof(Entry)), SEEK_SET) != 0
+            || fread(buffer.data(), sizeof(Entry), n, run.file) != n) {
+          throw IOException{ };
+        }
+      }
+      b++;
+    }
+
+    void closeRun( Run & run ) {
+      fclose(run.file);
+      std::remove(run.path.c_str());
+    }
+};
+
+// ExternalPQ class
+//
+// A priority queue for more tasks than fit in memory. The smallest
+// priorities live in an in-memory PQ (the hot tier); when it exceeds its
+// capacity, its larger half is written out as a sorted run file with
+// large sequential writes. deleteMin merges the hot tier with the heads of
+// all runs, reading each run sequentially a block at a time.
+//
+// Every insert or update gets a new version number, recorded per ID in a
+// DiskIndex. Records left behind in runs by updatePriority or remove are
+// not rewritten: they become stale once the index holds a newer version
+// (or a tombstone) for their ID, and are skipped when they reach the head.
+//
+// Template parameters: ID (trivially copyable and Comparable), P (priority type, default int)
+// Constructors:
+// ExternalPQ( dir, capacity ) --> constructs an empty queue spilling run files
+//                                 to directory dir beyond capacity tasks in memory
+// ******************PUBLIC OPERATIONS*********************
+// void insert( x, p )          --> Insert task ID x, which must not be in the queue, with priority p
+// void updatePriority( x, p )  --> Changes priority of ID x to p (if x not in queue, inserts x)
+// void remove( x )             --> Remove task ID x; nothing is done if x is not in the queue
+// bool contains( x )           --> Return true if task ID x is in the queue
+// ID findMin( )                --> Return a task ID with smallest priority, without removing it
+// ID deleteMin( )              --> Remove and return a task ID with smallest priority
+// bool isEmpty( )              --> Return true if empty; else false
+// long long size( )            --> Return the number of task IDs in the queue
+// int runCount( )              --> Return the number of open data run files
+// ******************ERRORS********************************
+// Throws UnderflowException as warranted
+// Throws IOException if a run file cannot be created, written or read
+
+template <typename ID, typename P = int>
+class ExternalPQ {
+
+    static_assert(is_trivially_copyable<ID>::value, "ExternalPQ writes IDs to disk as raw bytes");
+
+  public:
+
+    // Constructor
+    // Initializes an empty queue keeping at most capacity tasks in memory
+    // and writing run files to dir
+    explicit ExternalPQ( const string & dir = ".", int capacity = 1 << 20 )
+      : index(dir, clamped(capacity)), dir(dir), capacity(clamped(capacity)),
+        count(0), clock(0) {}
+
+    ~ExternalPQ() {
+      for (size_t r = 0; r < runs.size(); r++) {
+        closeRun(runs[r]);
+      }
+    }
+
+    ExternalPQ( const ExternalPQ & ) = delete;
+    ExternalPQ & operator=( const ExternalPQ & ) = delete;
+
+    // Emptiness check
+    bool isEmpty() const { return count == 0; }
+
+    // Return the number of task IDs in the queue
+    long long size() const { return count; }
+
+    // Return the number of open data run files
+    int runCount() const { return heads.size(); }
+
+    // Returns true if ID x is in the queue
+    bool contains( const ID & x ) {
+      return hot.contains(x) || index.lookup(x) != 0;
+    }
+
+    // Insert ID x with priority p
+    //    x must not already be in the queue; unlike updatePriority this
+    //    never reads the on-disk index
+    void insert( const ID & x, P p ) {
+      uint64_t v = ++clock;
+      hot.insert(x, p);
+      count++;
+      hotVersions[x] = v;
+      index.put(x, v);
+      if (hot.size() > capacity) {
+        spill();
+      }
+    }
+
+    // Update the priority of ID x to p
+    //    Inserts x with p if not in the queue
+    //    A copy of x already spilled to disk is left there as a stale record
+    void updatePriority( const ID & x, P p ) {
+      uint64_t v = ++clock;
+      uncheck(x);
+      if (hot.contains(x)) {
+        hot.updatePriority(x, p);
+      }
+      else {
+        if (index.lookup(x) == 0) {
+          count++;
+        }
+        hot.insert(x, p);
+      }
+      hotVersions[x] = v;
+      index.put(x, v);
+      if (hot.size() > capacity) {
+        spill();
+      }
+    }
+
+    // Remove ID x from the queue; nothing is done if x is not in the queue
+    void remove( const ID & x ) {
+      if (hot.contains(x)) {
+        hot.remove(x);
+        hotVersions.erase(x);
+      }
+      else if (index.lookup(x) == 0) {
+        return;
+      }
+      uncheck(x);
+      index.put(x, 0);
+      count--;
+    }
+
+    // Returns an ID with minimum priority without removing it
+    //     Throws exception if queue is empty
+    const ID & findMin() {
+      if (isEmpty()) {
+        throw UnderflowException{ };
+      }
+      if (fromHot()) {
+        return hot.findMin();
+      }
+      return runs[heads.findMin()].block[runs[heads.findMin()].pos].id;
+    }
+
+    // Deletes and Returns a task ID with minimum priority
+    //    Throws exception if queue is empty
+    ID deleteMin() {
+      if (isEmpty()) {
+        throw UnderflowException{ };
+      }
+      ID x;
+      if (fromHot()) {
+        x = hot.deleteMin();
+        hotVersions.erase(x);
+      }
+      else {
+        int r = heads.findMin();
+        x = runs[r].block[runs[r].pos].id;
+        advance(r);
+      }
+      index.put(x, 0);
+      count--;
+      return x;
+    }
+
+  private:
+
+    // Records per block for run reads and writes
+    static constexpr size_t BLOCK = 1 << 14;
+    // Data runs allowed before they are merged into one
+    static constexpr size_t MAX_RUNS = 32;
+
+    struct Record {
+      P priority;
+      uint64_t version;
+      ID id;
+    };
+
+    struct Run {
+      FILE *file;             // nullptr once the run is exhausted
+      string path;
+      size_t count;           // records in the file
+      size_t nextBlock;       // next block to read
+      vector<Record> block;   // current block
+      size_t pos;             // head record within block
+      bool checked;           // head record known to be current (listed in checkedHeads)
+    };
+
+    PQ<ID, P> hot;
+    map<ID, uint64_t> hotVersions;
+    DiskIndex<ID> index;
+    vector<Run> runs;
+    PQ<int, P> heads;         // run numbers keyed by the priority of their head record
+    map<ID, int> checkedHeads;  // run of each head record already checked against the index
+    string dir;
+    int capacity;
+    long long count;
+    uint64_t clock;
+
+    // The hot tier must hold at least two tasks, so spill() keeps half
+    static int clamped( int capacity ) {
+      return capacity < 2 ? 2 : capacity;
+    }
+
+    // Drop stale run heads, then report whether the hot tier holds the minimum
+    //    each head is looked up in the index once; the result is kept until
+    //    the head moves on or its ID is updated or removed
+    bool fromHot() {
+      while (!heads.isEmpty()) {
+        int r = heads.findMin();
+        Run & run = runs[r];
+        if (run.checked) {
+          break;
+        }
+        Record & head = run.block[run.pos];
+        if (index.lookup(head.id) == head.version) {
+          run.checked = true;
+          checkedHeads[head.id] = r;
+          break;
+        }
+        advance(r);
+      }
+      return heads.isEmpty()
+             || (!hot.isEmpty() && !(heads.findMinPriority() < hot.findMinPriority()));
+    }
+
+    // Forget that x's record at the head of a run was checked, as x is changing
+    void uncheck( const ID & x ) {
+      typename map<ID, int>::iterator it = checkedHeads.find(x);
+      if (it != checkedHeads.end()) {
+        runs[it->second].checked = false;
+        checkedHeads.erase(it);
+      }
+    }
+
+    // Move run r past its head record, closing it when exhausted
+    void advance( int r ) {
+      Run & run = runs[r];
+      if (run.checked) {
+        checkedHeads.erase(run.block[run.pos].id);
+        run.checked = false;
+      }
+      if (++run.pos == run.block.size()) {
+        refill(run);
+      }
+      if (run.block.empty()) {
+        heads.remove(r);
+        closeRun(run);
+      }
+      else {
+        heads.updatePriority(r, run.block[run.pos].priority);
+      }
+    }
+
+    // Write the larger half of the hot tier to a new sorted run
+    void spill() {
+      int length = hot.size();
+      int keep = length / 2;
+      vector<ID> keptIDs;
+      vector<P> keptPriorities;
+      Run run = createRun();
+      vector<Record> out;
+      out.reserve(BLOCK);
+      for (int i = 0; i < length; i++) {
+        P p = hot.findMinPriority();
+        ID x = hot.deleteMin();
+        if (i < keep) {
+          keptIDs.push_back(x);
+          keptPriorities.push_back(p);
+        }
+        else {
+          pushRecord(out, p, hotVersions[x], x);
+          hotVersions.erase(x);
+          if (out.size() == BLOCK) {
+            appendBlock(run, out);
+          }
+        }
+      }
+      appendBlock(run, out);
+      hot = PQ<ID, P>(keptIDs, keptPriorities);
+      addRun(run);
+      if (heads.size() > (int) MAX_RUNS) {
+        mergeRuns();
+      }
+    }
+
+    // Merge the unread parts of every run into one run, sequentially,
+    // dropping records the index shows were updated or removed since
+    void mergeRuns() {
+      Run merged = createRun();
+      vector<Record> out;
+      out.reserve(BLOCK);
+      while (!heads.isEmpty()) {
+        int r = heads.findMin();
+        const Record & head = runs[r].block[runs[r].pos];
+        if (runs[r].checked || index.lookup(head.id) == head.version) {
+          pushRecord(out, head.priority, head.version, head.id);
+          if (out.size() == BLOCK) {
+            appendBlock(merged, out);
+          }
+        }
+        advance(r);
+      }
+      appendBlock(merged, out);
+      runs.clear();
+      addRun(merged);
+    }
+
+    // Rewind a freshly written run and make its head visible to deleteMin
+    void addRun( Run & run ) {
+      if (run.count == 0) {
+        closeRun(run);
+        return;
+      }
+      run.nextBlock = 0;
+      run.checked = false;
+      refill(run);
+      // reuse the slot of an exhausted run, so run numbers stay small
+      size_t r = 0;
+      while (r < runs.size() && runs[r].file != nullptr) {
+        r++;
+      }
+      if (r == runs.size()) {
+        runs.push_back(run);
+      }
+      else {
+        runs[r] = run;
+      }
+      heads.insert(r, run.block[0].priority);
+    }
+
+    Run createRun() {
+      Run run;
+      run.file = createRunFile(dir, "pq-data.", run.path);
+      run.count = 0;
+      run.nextBlock = 0;
+      run.pos = 0;
+      run.checked = false;
+      return run;
+    }
+
+    // Append a record whose padding bytes are zeroed, as it goes to disk raw
+    static void pushRecord( vector<Record> & out, P p, uint64_t v, const ID & x ) {
+      out.emplace_back();
+      out.back().priority = p;
+      out.back().version = v;
+      out.back().id = x;
+    }
+
+    void appendBlock( Run & run, vector<Record> & out ) {
+      if (out.empty()) {
+        return;
+      }
+      if (fwrite(out.data(), sizeof(Record), out.size(), run.file) != out.size()) {
+        throw IOException{ };
+      }
+      run.count += out.size();
+      out.clear();
+    }
+
+    // Read the next block of run; the block is left empty at the end of the run
+    void refill( Run & run ) {
+      size_t first = run.nextBlock * BLOCK;
+      size_t n = first < run.count ? min(BLOCK, run.count - first) : 0;
+      run.block.resize(n);
+      run.pos = 0;
+      if (n > 0) {
+        if (fseek(run.file, (long) (first * sizeof(Record)), SEEK_SET) != 0
+            || fread(run.block.data(), sizeof(Record), n, run.file) != n) {
+          throw IOException{ };
+        }
+      }
+      run.nextBlock++;
+      if (n == 0) {
+        vector<Record>().swap(run.block);
+      }
+    }
+
+    void closeRun( Run & run ) {
+      if (run.file != nullptr) {
+        fclose(run.file);
+        run.file = nullptr;
+        std::remove(run.path.c_str());
+      }
+    }
+};
+#endif
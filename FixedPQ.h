@@ -0,0 +1,346 @@
+#ifndef FIXED_PQ_H
+#define FIXED_PQ_H
+
+// FixedPQ class
+//
+// A fixed-capacity version of PQ for latency-critical code. The heap
+// array, the AVL index nodes and their free list are all stored inline
+// and sized at compile time, so no operation ever allocates, and each
+// runs in O(log N) worst case. Failures are reported with a PQStatus
+// return code instead of an exception.
+//
+// Template parameters: ID, N (capacity), P (priority type, default int)
+//   ID must be Comparable and copyable without allocating; to declare a
+//   constexpr FixedPQ, ID and P must be literal types.
+// Constructors:
+// FixedPQ --> constructs a new empty queue (constexpr)
+// ******************PUBLIC OPERATIONS*********************
+// PQStatus insert( x, p )          --> Insert task ID x with priority p
+// PQStatus findMin( out )          --> Copy a task ID with smallest priority into out
+// PQStatus deleteMin( out )        --> Remove a task ID with smallest priority into out
+// PQStatus updatePriority( x, p )  --> Changes priority of ID x to p (if x not in PQ, inserts x)
+// PQStatus remove( x )             --> Remove task ID x
+// bool contains( x )               --> Return true if task ID x is in the queue
+// bool isEmpty( )                  --> Return true if empty; else false
+// bool isFull( )                   --> Return true if size() == capacity(); else false
+// int size( )                      --> Return the number of task IDs in the queue
+// int capacity( )                  --> Return N
+// void makeEmpty( )                --> Remove all task IDs
+// ******************ERRORS********************************
+// PQStatus::Full      --> insert of a new ID while size() == N
+// PQStatus::Empty     --> findMin or deleteMin on an empty queue
+// PQStatus::Duplicate --> insert of an ID that is already queued
+// PQStatus::NotFound  --> remove of an ID that is not queued
+
+enum class PQStatus { Ok, Full, Empty, Duplicate, NotFound };
+
+template <typename ID, int N, typename P = int>
+class FixedPQ {
+
+    static_assert(N > 0, "FixedPQ needs a positive capacity");
+
+  public:
+
+    // Constructor
+    // Initializes a new empty queue; usable in constant expressions
+    constexpr FixedPQ() : heap{}, nodes{}, root(NIL), count(0), unused(0), freeList(NIL) {}
+
+    constexpr bool isEmpty() const noexcept { return count == 0; }
+
+    constexpr bool isFull() const noexcept { return count == N; }
+
+    constexpr int size() const noexcept { return count; }
+
+    static constexpr int capacity() noexcept { return N; }
+
+    // Returns true if ID x is in the queue
+    bool contains( const ID & x ) const noexcept {
+      return find(x) != NIL;
+    }
+
+    // Insert ID x with priority p
+    //    Returns Full if the queue is at capacity, Duplicate if x is queued
+    PQStatus insert( const ID & x, P p ) noexcept {
+      if (find(x) != NIL) {
+        return PQStatus::Duplicate;
+      }
+      if (count == N) {
+        return PQStatus::Full;
+      }
+      int n = allocate();
+      nodes[n].id = x;
+      nodes[n].left = NIL;
+      nodes[n].right = NIL;
+      nodes[n].height = 0;
+      link(n, root);
+
+      int index = count++;
+      heap[index].priority = p;
+      heap[index].node = n;
+      nodes[n].slot = index;
+      percolateUp(index);
+      return PQStatus::Ok;
+    }
+
+    // Copy an ID with minimum priority into out without removing it
+    //    Returns Empty if the queue is empty
+    PQStatus findMin( ID & out ) const noexcept {
+      if (count == 0) {
+        return PQStatus::Empty;
+      }
+      out = nodes[heap[0].node].id;
+      return PQStatus::Ok;
+    }
+
+    // Remove an ID with minimum priority into out
+    //    Returns Empty if the queue is empty
+    PQStatus deleteMin( ID & out ) noexcept {
+      if (count == 0) {
+        return PQStatus::Empty;
+      }
+      out = nodes[heap[0].node].id;
+      removeSlot(0);
+      return PQStatus::Ok;
+    }
+
+    // Update the priority of ID x to p
+    //    Inserts x with p if not in the queue (and returns Full if there is no room)
+    PQStatus updatePriority( const ID & x, P p ) noexcept {
+      int n = find(x);
+      if (n == NIL) {
+        return insert(x, p);
+      }
+      int index = nodes[n].slot;
+      if (heap[index].priority < p) {
+        heap[index].priority = p;
+        percolateDown(index);
+      }
+      else {
+        heap[index].priority = p;
+        percolateUp(index);
+      }
+      return PQStatus::Ok;
+    }
+
+    // Remove ID x from the queue
+    //    Returns NotFound if x is not in the queue
+    PQStatus remove( const ID & x ) noexcept {
+      int n = find(x);
+      if (n == NIL) {
+        return PQStatus::NotFound;
+      }
+      removeSlot(nodes[n].slot);
+      return PQStatus::Ok;
+    }
+
+    // Delete all IDs from the queue
+    void makeEmpty() noexcept {
+      root = NIL;
+      count = 0;
+      unused = 0;
+      freeList = NIL;
+    }
+
+  private:
+
+    static constexpr int NIL = -1;
+
+    struct HeapEntry {
+      P priority;
+      int node;      // index of the task's AVL node
+    };
+
+    // AVL node linked by index; free nodes are chained through left
+    struct Node {
+      ID id;
+      int slot;      // heap index of the task
+      int left;
+      int right;
+      int height;
+    };
+
+    HeapEntry heap[N];
+    Node nodes[N];
+    int root;
+    int count;
+    int unused;      // nodes[unused..N) have never been allocated
+    int freeList;
+
+    int allocate() noexcept {
+      if (freeList != NIL) {
+        int n = freeList;
+        freeList = nodes[n].left;
+        return n;
+      }
+      return unused++;
+    }
+
+    void release( int n ) noexcept {
+      nodes[n].left = freeList;
+      freeList = n;
+    }
+
+    // Remove the task at heap index i from the heap and the index
+    void removeSlot( int i ) noexcept {
+      int n = heap[i].node;
+      int last = --count;
+      if (i != last) {
+        int moved = heap[last].node;
+        heap[i] = heap[last];
+        nodes[moved].slot = i;
+        percolateUp(i);
+        percolateDown(nodes[moved].slot);
+      }
+      unlink(nodes[n].id, root);
+      release(n);
+    }
+
+    void percolateDown( int i ) noexcept {
+      HeapEntry moving = heap[i];
+      while (2 * i + 1 < count) {
+        int child = 2 * i + 1;
+        if (child + 1 < count && heap[child + 1].priority < heap[child].priority) {
+          child++;
+        }
+        if (!(heap[child].priority < moving.priority)) {
+          break;
+        }
+        heap[i] = heap[child];
+        nodes[heap[i].node].slot = i;
+        i = child;
+      }
+      heap[i] = moving;
+      nodes[moving.node].slot = i;
+    }
+
+    void percolateUp( int i ) noexcept {
+      HeapEntry moving = heap[i];
+      while (i > 0 && moving.priority < heap[(i - 1) / 2].priority) {
+        heap[i] = heap[(i - 1) / 2];
+        nodes[heap[i].node].slot = i;
+        i = (i - 1) / 2;
+      }
+      heap[i] = moving;
+      nodes[moving.node].slot = i;
+    }
+
+    // AVL index, as in AvlTree but with nodes addressed by position
+
+    int find( const ID & x ) const noexcept {
+      int t = root;
+      while (t != NIL) {
+        if (x < nodes[t].id) {
+          t = nodes[t].left;
+        }
+        else if (nodes[t].id < x) {
+          t = nodes[t].right;
+        }
+        else {
+          return t;
+        }
+      }
+      return NIL;
+    }
+
+    // Link node n (not yet in the tree) into subtree t
+    void link( int n, int & t ) noexcept {
+      if (t == NIL) {
+        t = n;
+        return;
+      }
+      if (nodes[n].id < nodes[t].id) {
+        link(n, nodes[t].left);
+      }
+      else {
+        link(n, nodes[t].right);
+      }
+      balance(t);
+    }
+
+    // Unlink the node holding x from subtree t, keeping the node itself
+    void unlink( const ID & x, int & t ) noexcept {
+      if (t == NIL) {
+        return;
+      }
+      if (x < nodes[t].id) {
+        unlink(x, nodes[t].left);
+      }
+      else if (nodes[t].id < x) {
+        unlink(x, nodes[t].right);
+      }
+      else if (nodes[t].left != NIL && nodes[t].right != NIL) {
+        int old = t;
+        int successor = detachMin(nodes[t].right);
+        nodes[successor].left = nodes[old].left;
+        nodes[successor].right = nodes[old].right;
+        t = successor;
+      }
+      else {
+        t = (nodes[t].left != NIL) ? nodes[t].left : nodes[t].right;
+      }
+      balance(t);
+    }
+
+    int detachMin( int & t ) noexcept {
+      if (nodes[t].left == NIL) {
+        int n = t;
+        t = nodes[t].right;
+        return n;
+      }
+      int n = detachMin(nodes[t].left);
+      balance(t);
+      return n;
+    }
+
+    int height( int t ) const noexcept {
+      return t == NIL ? -1 : nodes[t].height;
+    }
+
+    void balance( int & t ) noexcept {
+      if (t == NIL) {
+        return;
+      }
+      if (height(nodes[t].left) - height(nodes[t].right) > 1) {
+        if (height(nodes[nodes[t].left].left) >= height(nodes[nodes[t].left].right)) {
+          rotateWithLeftChild(t);
+        }
+        else {
+          rotateWithRightChild(nodes[t].left);
+          rotateWithLeftChild(t);
+        }
+      }
+      else if (height(nodes[t].right) - height(nodes[t].left) > 1) {
+        if (height(nodes[nodes[t].right].right) >= height(nodes[nodes[t].right].left)) {
+          rotateWithRightChild(t);
+        }
+        else {
+          rotateWithLeftChild(nodes[t].right);
+          rotateWithRightChild(t);
+        }
+      }
+      nodes[t].height = maxHeight(nodes[t].left, nodes[t].right) + 1;
+    }
+
+    int maxHeight( int a, int b ) const noexcept {
+      return height(a) > height(b) ? height(a) : height(b);
+    }
+
+    void rotateWithLeftChild( int & k2 ) noexcept {
+      int k1 = nodes[k2].left;
+      nodes[k2].left = nodes[k1].right;
+      nodes[k1].right = k2;
+      nodes[k2].height = maxHeight(nodes[k2].left, nodes[k2].right) + 1;
+      nodes[k1].height = maxHeight(nodes[k1].left, k2) + 1;
+      k2 = k1;
+    }
+
+    void rotateWithRightChild( int & k1 ) noexcept {
+      int k2 = nodes[k1].right;
+      nodes[k1].right = nodes[k2].left;
+      nodes[k2].left = k1;
+      nodes[k1].height = maxHeight(nodes[k1].left, nodes[k1].right) + 1;
+      nodes[k2].height = maxHeight(nodes[k2].right, k1) + 1;
+      k1 = k2;
+    }
+};
+#endif
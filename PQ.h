@@ -3,53 +3,149 @@
 
 #include "dsexceptions.h"
 #include "AvlTree.h"
+#include "DenseIndex.h"
+#include <climits>
+#include <limits>
 #include <cmath>
 #include <algorithm>
 #include <iostream> 
+#include <type_traits>
 #include <vector>
 using namespace std;
 // PQ class
 //
-// Template parameter: ID
+// Template parameters: ID, P (priority type, default int),
+//   Index (ID index, default PQIndexFor<ID>::type: DenseIndex<ID> for integral
+//   IDs with a declared IDUniverse, else AvlTree<ID>; BTreeIndex<ID> is the
+//   cache-friendlier ordered choice for very large queues)
 // Constructors:
 // PQ --> constructs a new empty queue
+// PQ( stable ) --> constructs a new empty queue; if stable, equal priorities leave in FIFO order
 // PQ( tasks, array ) --> constructs a new queue with a given set of task IDs and array 
+// PQ( tasks, array, stable ) --> as above, optionally in stable (FIFO) mode
+// PQ( tasks, array, pool, stable ) --> as above, building the heap and AVL tree on a TaskPool
 // ******************PUBLIC OPERATIONS*********************
 // void insert( x, p )       --> Insert task ID x with priority p 
 // ID findMin( )  --> Return a task ID with smallest priority, without removing it 
 // ID deleteMin( )   --> Remove and return a task ID with smallest priority 
 // void updatePriority( x, p )   --> Changes priority of ID x to p (if x not in PQ, inserts x);
 // bool isEmpty( )   --> Return true if empty; else false
+// bool isStable( )  --> Return true if equal priorities are dequeued in FIFO order
+// P findMinPriority( )  --> Return the smallest priority, without removing it
+// bool contains( x )  --> Return true if task ID x is in the queue
+// void remove( x )  --> Remove task ID x; nothing is done if x is not in the queue
 // int size() --> return the number of task IDs in the queue 
 // void makeEmpty( )  --> Remove all task IDs (and their array)
+// void merge( other )  --> Move all of other's tasks into this queue in linear time
+// PQ splitByID( pivot )  --> Move tasks with ID >= pivot into a new queue, in linear time
+// void ageAll( delta )  --> Lower the priority of every queued task by delta, in O(1)
 // ******************ERRORS********************************
 // Throws UnderflowException as warranted
+// Throws IllegalArgumentException if ageAll is given a negative delta
+// Throws IllegalArgumentException if the parallel constructor is given duplicate IDs
 
+// Default index for ID: a direct-address table when the IDs are declared dense
 template <typename ID>
+struct PQIndexFor {
+    typedef typename conditional<(is_integral<ID>::value && IDUniverse<ID>::size > 0),
+                                 DenseIndex<ID>, AvlTree<ID>>::type type;
+};
+
+template <typename ID, typename P = int, typename Index = typename PQIndexFor<ID>::type>
 // ID is the type of task IDs to be used; the type must be Comparable (i.e., have < defined), so IDs can be AVL Tree keys.
+// P is the priority type: a signed integer type of at most 64 bits (e.g. long long for epoch-millis deadlines).
+// Index maps each ID to its heap index; it hands PQ a Handle per ID (see AvlTree's private section).
 class PQ {
 
   public:
     
     // Constructor
     // Initializes a new empty PQ
-    PQ() {}
+    PQ() : seq(0), seqStep(0), offset(0) {}
+    // Constructor
+    // Initializes a new empty PQ; in stable mode, tasks with equal priority
+    // are removed in the order they were inserted (or last updated)
+    explicit PQ( bool stable ) : seq(0), seqStep(stable ? 1 : 0), offset(0) {}
     // Constructor
     // Initializes a new PQ with a given set of tasks IDs and array  
     //      priority[i] is the priority for ID task[i] 
-    PQ( const vector<ID> & tasks, const vector<int> & array ) { 
+    //      in stable mode, ties are broken by position in tasks
+    PQ( const vector<ID> & tasks, const vector<P> & array, bool stable = false )
+      : seq(0), seqStep(stable ? 1 : 0), offset(0) { 
       int length = array.size();
 
       for (int i = 0; i < length; i++) {
+        Key key = nextKey(array[i]);
         nodes.push_back(PQnode());
-        nodes[i].priority = array[i];
-        void* ptr = tree.insert(tasks[i], i);
-        typename AvlTree<ID>::AvlNode* z = (typename AvlTree<ID>::AvlNode*) ptr;
-        nodes[i].pointer = z;
+        nodes[i].key = key;
+        nodes[i].handle = tree.insert(tasks[i], i);
       }
       buildHeap();
     } 
 
+    // Constructor
+    // Initializes a new PQ with a given set of tasks IDs and array, using the
+    // threads of pool: the index is bulk-loaded in parallel (for AvlTree,
+    // nodes are sorted by ID and linked bottom-up), the heap is built level by level with the
+    // subtrees of each level sifted in parallel, and the back-links are
+    // fixed up in one parallel pass at the end
+    //      priority[i] is the priority for ID task[i]; IDs must be distinct
+    PQ( const vector<ID> & tasks, const vector<P> & array, TaskPool & pool, bool stable = false )
+      : seq(stable ? array.size() : 0), seqStep(stable ? 1 : 0), offset(0) {
+      long length = array.size();
+      vector<Handle> handles;
+      if (!tree.bulkLoad(tasks, handles, pool)) {
+        throw IllegalArgumentException{ };
+      }
+
+      nodes.resize(length);
+      unsigned int step = seqStep;
+      pool.parallelFor(0, length, [&](long lo, long hi) {
+        for (long i = lo; i < hi; i++) {
+          nodes[i].key = makeKey(array[i], i * step);
+          nodes[i].handle = handles[i];
+        }
+      });
+
+      // nodes on one level root disjoint subtrees, so each level's sifts run in parallel
+      long levelStart = 1;
+      while (levelStart * 2 - 1 < length / 2) {
+        levelStart *= 2;
+      }
+      for (; levelStart >= 1; levelStart /= 2) {
+        long lo = levelStart - 1;
+        long hi = min(levelStart * 2 - 1, length / 2);
+        pool.parallelFor(lo, hi, [this](long from, long to) {
+          for (long i = from; i < to; i++) {
+            siftDown(i);
+          }
+        });
+      }
+
+      pool.parallelFor(0, length, [this](long lo, long hi) {
+        for (long i = lo; i < hi; i++) {
+          tree.slotOf(nodes[i].handle) = i;
+        }
+      });
+    }
+
+    // Move constructor
+    PQ( PQ && rhs ) : tree(std::move(rhs.tree)), nodes(std::move(rhs.nodes)),
+                      seq(rhs.seq), seqStep(rhs.seqStep), offset(rhs.offset) {
+      rhs.nodes.clear();
+    }
+
+    // Move assignment
+    PQ & operator=( PQ && rhs ) {
+      tree = std::move(rhs.tree);
+      nodes = std::move(rhs.nodes);
+      rhs.nodes.clear();
+      seq = rhs.seq;
+      seqStep = rhs.seqStep;
+      offset = rhs.offset;
+      return *this;
+    }
+
     ~PQ() {
       makeEmpty();
     }
@@ -57,19 +153,22 @@ class PQ {
     // Emptiness check 
     bool isEmpty() const { return size() == 0;}
 
+    // Stable (FIFO among equal priorities) mode check
+    bool isStable() const { return seqStep != 0; }
+
     // Deletes and Returns a task ID with minimum priority
     //    Throws exception if queue is empty
-    const ID & deleteMin() {
+    ID deleteMin() {
 
        if( isEmpty( ) )
           throw UnderflowException{ };
 
       int length = size();
-      ID min_id = nodes[0].pointer->id_num;
-      swap(&nodes[0].priority, &nodes[length-1].priority);
-      swap(&nodes[0].pointer->index, &nodes[length-1].pointer->index);
-      swapP(nodes[0].pointer, nodes[length-1].pointer);
-      tree.remove(nodes[length-1].pointer->id_num);
+      ID min_id = tree.idOf(nodes[0].handle);
+      swapK(&nodes[0].key, &nodes[length-1].key);
+      swap(&tree.slotOf(nodes[0].handle), &tree.slotOf(nodes[length-1].handle));
+      swapP(nodes[0].handle, nodes[length-1].handle);
+      tree.remove(min_id);
       nodes.pop_back();
       
       percolateDown(0);
@@ -84,20 +183,52 @@ class PQ {
       if( isEmpty( ) )
           throw UnderflowException{ };
 
-      return nodes[0].pointer->id_num;
+      return tree.idOf(nodes[0].handle);
+    }
+
+    // Returns the minimum priority without removing its task
+    //     Throws exception if queue is empty
+    P findMinPriority() const {
+
+      if( isEmpty( ) )
+          throw UnderflowException{ };
+
+      return (P) (priorityOf(nodes[0].key) + offset);
+    }
+
+    // Returns true if ID x is in the queue
+    bool contains( const ID & x ) const {
+      return tree.contains(x);
+    }
+
+    // Remove ID x from the queue; nothing is done if x is not in the queue
+    void remove( const ID & x ) {
+      int index = tree.findIndex(x);
+      if (index < 0) {
+        return;
+      }
+
+      int last = size() - 1;
+      swapK(&nodes[index].key, &nodes[last].key);
+      swap(&tree.slotOf(nodes[index].handle), &tree.slotOf(nodes[last].handle));
+      swapP(nodes[index].handle, nodes[last].handle);
+      tree.remove(x);
+      nodes.pop_back();
+
+      if (index < size()) {
+        percolateUp(index);
+        percolateDown(index);
+      }
     }
 
     // Insert ID x with priority p.
-    void insert( const ID & x, int p ) {
+    //    The index insert comes first, so an ID the index rejects (e.g. one
+    //    outside a DenseIndex's universe) leaves the queue unchanged
+    void insert( const ID & x, P p ) {
       
-      nodes.push_back(PQnode());
-      int length = nodes.size();
-      int index = length-1;
-      nodes[index].priority = p;
-
-      void* ptr = tree.insert(x, index);
-      typename AvlTree<ID>::AvlNode* z = (typename AvlTree<ID>::AvlNode*) ptr;
-      nodes[index].pointer = z;
+      int index = nodes.size();
+      Handle handle = tree.insert(x, index);
+      nodes.push_back(PQnode{ nextKey(p), handle });
 
       percolateUp(index);
     }
@@ -106,18 +237,20 @@ class PQ {
     //    Inserts x with p if not in the queue
 
     // search AVL tree for ID x and update heap with priority p in O(logn) time
-    void updatePriority( const ID & x, int p ) {
+    // in stable mode x moves to the back of its new priority level
+    void updatePriority( const ID & x, P p ) {
         if (tree.contains(x) == false) {
           insert(x, p);
         }
         else {
           int index = tree.findIndex(x);
-          if (nodes[index].priority < p) {
-            nodes[index].priority = p;
+          Key key = nextKey(p);
+          if (nodes[index].key < key) {
+            nodes[index].key = key;
             percolateDown(index);
           }
           else {
-            nodes[index].priority = p;
+            nodes[index].key = key;
             percolateUp(index);
           }
         }
@@ -130,6 +263,14 @@ class PQ {
 
     // Delete all IDs from the PQ
     void makeEmpty() {
+      if constexpr (denseIndex) {
+        // clear only the table slots the heap uses, not the whole universe
+        for (size_t i = 0; i < nodes.size(); i++) {
+          tree.remove(tree.idOf(nodes[i].handle));
+        }
+        nodes.clear();
+        return;
+      }
       int length = nodes.size();
       
       for (int i = 0; i < length; i++) {
@@ -138,6 +279,152 @@ class PQ {
       tree.makeEmpty();
     }
 
+    // Move all tasks of other into this queue, leaving other empty
+    //    if an ID is in both queues, other's priority wins
+    // the heap arrays are concatenated and re-heapified in O(n); the AVL trees
+    // are joined in O(log n) when their ID ranges are disjoint, else rebuilt in O(n);
+    // other's IDs are moved into a DenseIndex one at a time, walking other's heap
+    void merge( PQ && other ) {
+      if (&other == this) {
+        return;
+      }
+      // bring both queues' keys to the same aging base before mixing them
+      if (offset != other.offset) {
+        rebase();
+        other.rebase();
+      }
+      int start = nodes.size();
+      int length = other.nodes.size();
+      if (seq < other.seq) {
+        seq = other.seq;
+      }
+
+      vector<bool> live;
+      bool superseded = false;
+      if constexpr (denseIndex) {
+        live.assign(start + length, true);
+        for (int i = 0; i < length; i++) {
+          ID x = other.tree.idOf(other.nodes[i].handle);
+          int mine = tree.findIndex(x);
+          if (mine >= 0) {
+            live[mine] = false;
+            superseded = true;
+          }
+          tree.slotOf(tree.insert(x, start + i)) = start + i;
+          other.tree.remove(x);
+          nodes.push_back(other.nodes[i]);
+        }
+        other.nodes.clear();
+      }
+      else {
+        for (int i = 0; i < length; i++) {
+          nodes.push_back(other.nodes[i]);
+          other.tree.slotOf(other.nodes[i].handle) = start + i;
+        }
+        other.nodes.clear();
+
+        vector<int> displaced;
+        tree.merge(std::move(other.tree), displaced);
+        superseded = displaced.size() > 0;
+
+        // the index may have moved its entries, so re-read every handle
+        live.assign(nodes.size(), !superseded);
+        tree.forEach([this, &live](Handle h) {
+          int slot = tree.slotOf(h);
+          nodes[slot].handle = h;
+          live[slot] = true;
+        });
+      }
+      if (superseded) {
+        // drop the heap slots of this queue's superseded entries
+        int kept = 0;
+        for (int i = 0; i < size(); i++) {
+          if (live[i]) {
+            nodes[kept] = nodes[i];
+            tree.slotOf(nodes[kept].handle) = kept;
+            kept++;
+          }
+        }
+        nodes.resize(kept);
+      }
+      buildHeap();
+    }
+
+    // Split off the tasks whose ID is not less than pivot into a new queue
+    //    this queue keeps the IDs below pivot; both keep the stable setting
+    // an AVL index is split in O(log n); each heap array is rebuilt in O(n)
+    // (a DenseIndex is split by walking the heap, but with a declared
+    // IDUniverse it also allocates the new queue's table, in O(universe))
+    PQ splitByID( const ID & pivot ) {
+      PQ upper(isStable());
+      upper.seq = seq;
+      upper.offset = offset;
+      vector<PQnode> old;
+      old.swap(nodes);
+
+      if constexpr (denseIndex) {
+        for (size_t i = 0; i < old.size(); i++) {
+          ID x = tree.idOf(old[i].handle);
+          if (x < pivot) {
+            tree.slotOf(old[i].handle) = nodes.size();
+            nodes.push_back(old[i]);
+          }
+          else {
+            tree.remove(x);
+            upper.tree.insert(x, upper.nodes.size());
+            upper.nodes.push_back(old[i]);
+          }
+        }
+      }
+      else {
+        tree.split(pivot, upper.tree);
+
+        // each index still records the old heap index of its IDs
+        tree.forEach([this, &old](Handle h) {
+          nodes.push_back(PQnode{ old[tree.slotOf(h)].key, h });
+          tree.slotOf(h) = nodes.size() - 1;
+        });
+        upper.tree.forEach([&upper, &old](Handle h) {
+          upper.nodes.push_back(PQnode{ old[upper.tree.slotOf(h)].key, h });
+          upper.tree.slotOf(h) = upper.nodes.size() - 1;
+        });
+      }
+
+      buildHeap();
+      upper.buildHeap();
+      return upper;
+    }
+
+    // Lower the priority of every queued task by delta (tasks inserted later
+    // are not affected), so long-waiting tasks eventually reach the front
+    //    Throws IllegalArgumentException if delta is negative
+    // runs in O(1): the shift is kept in a global offset rather than in each
+    // key; if a priority would fall below the smallest P, the aged priorities
+    // saturate there and the heap is rebuilt in O(n)
+    void ageAll( P delta ) {
+      if (delta < 0) {
+        throw IllegalArgumentException{ };
+      }
+      if (isEmpty()) {
+        return;
+      }
+      if (priorityOf(nodes[0].key) + offset - delta >= numeric_limits<P>::min()) {
+        offset -= delta;
+        return;
+      }
+
+      int length = nodes.size();
+      for (int i = 0; i < length; i++) {
+        Key aged = priorityOf(nodes[i].key) + offset - delta;
+        if (aged < numeric_limits<P>::min()) {
+          aged = numeric_limits<P>::min();
+        }
+        nodes[i].key = makeKey((P) aged, nodes[i].key & (seqRange() - 1));
+      }
+      offset = 0;
+      buildHeap();
+    }
+
     void display() 
     {
       int length = nodes.size();
@@ -147,7 +434,7 @@ class PQ {
       }
       else if (length > 0) {
         for( int i = 0; i < length; i++){
-          cout << "PQ Index: " << i << "  Priority: " << nodes[i].priority << " ------------>>>" << "  AVL Index: " << nodes[i].pointer->index <<  "  ID: " << nodes[i].pointer->id_num << endl;
+          cout << "PQ Index: " << i << "  Priority: " << (P) (priorityOf(nodes[i].key) + offset) << " ------------>>>" << "  AVL Index: " << tree.slotOf(nodes[i].handle) <<  "  ID: " << tree.idOf(nodes[i].handle) << endl;
         }
       }
       
@@ -157,13 +444,84 @@ class PQ {
 
   private:
 
+    // The heap orders on a single wide key: the priority in the high bits
+    // and an insertion sequence number in the low 32 bits, so FIFO tie-breaking
+    // costs no extra comparisons. Outside stable mode the sequence stays 0.
+    // 32-bit priorities pack into a long long, 64-bit ones into an __int128.
+    typedef typename conditional<(sizeof(P) <= 4), long long, __int128>::type Key;
+
+    static Key seqRange() { return (Key) 1 << 32; }
+
+    typedef typename Index::Handle Handle;
+
+    // A DenseIndex has no list of its IDs, so PQ walks the heap for it
+    static constexpr bool denseIndex = is_same<Index, DenseIndex<ID>>::value;
+
     struct PQnode {
-      int priority;
-      typename AvlTree<ID>::AvlNode* pointer;
+      Key key;
+      Handle handle;
     };
 
-    AvlTree<ID> tree;
+    Index tree;
     vector<PQnode> nodes;
+    unsigned int seq;      // next sequence number to hand out
+    unsigned int seqStep;  // 1 in stable mode, 0 otherwise
+    Key offset;            // true priority = priority stored in the key + offset
+
+    static Key makeKey(P p, unsigned int s) {
+      return (Key) p * seqRange() + s;
+    }
+
+    static P priorityOf(Key key) {
+      return (P) ((key - (key & (seqRange() - 1))) / seqRange());
+    }
+
+    // Builds the key for a newly (re)prioritized task
+    Key nextKey(P p) {
+      if (seq > UINT_MAX - seqStep) {
+        renumber();
+      }
+      Key stored = p - offset;
+      if (stored < numeric_limits<P>::min() || stored > numeric_limits<P>::max()) {
+        rebase();
+        stored = p;
+      }
+      Key key = makeKey((P) stored, seq);
+      seq += seqStep;
+      return key;
+    }
+
+    // Compacts the sequence numbers of queued tasks to 0..n-1, keeping their
+    // relative order, so the counter can continue after 2^32 insertions.
+    // Key order is unchanged, so the heap needs no repair.
+    void renumber() {
+      int length = nodes.size();
+      vector<int> order(length);
+      for (int i = 0; i < length; i++) {
+        order[i] = i;
+      }
+      sort(order.begin(), order.end(), [this](int a, int b) {
+        return nodes[a].key < nodes[b].key;
+      });
+      for (int r = 0; r < length; r++) {
+        PQnode & n = nodes[order[r]];
+        n.key = makeKey(priorityOf(n.key), r);
+      }
+      seq = length;
+    }
+
+    // Folds the aging offset into every key, so keys hold true priorities
+    // again; these always fit in P, and key order is unchanged
+    void rebase() {
+      if (offset == 0) {
+        return;
+      }
+      int length = nodes.size();
+      for (int i = 0; i < length; i++) {
+        nodes[i].key = makeKey((P) (priorityOf(nodes[i].key) + offset), nodes[i].key & (seqRange() - 1));
+      }
+      offset = 0;
+    }
 
     void swap(int *r, int *s)
     {
@@ -173,8 +531,15 @@ class PQ {
       return;
     }
 
-    void swapP(typename AvlTree<ID>::AvlNode*& x, typename AvlTree<ID>::AvlNode*& y) {
-      typename AvlTree<ID>::AvlNode* temp = x;
+    void swapK(Key *r, Key *s)
+    {
+      Key temp = *r;
+      *r = *s;
+      *s = temp;
+    }
+
+    void swapP(Handle& x, Handle& y) {
+      Handle temp = x;
       x = y;
       y = temp;
     }
@@ -186,6 +551,24 @@ class PQ {
       }
     }
 
+    // percolateDown without back-link updates, for the parallel constructor
+    void siftDown(long i) {
+      long length = nodes.size();
+      PQnode moving = nodes[i];
+      while (2 * i + 1 < length) {
+        long child = 2 * i + 1;
+        if (child + 1 < length && nodes[child + 1].key < nodes[child].key) {
+          child++;
+        }
+        if (!(nodes[child].key < moving.key)) {
+          break;
+        }
+        nodes[i] = nodes[child];
+        i = child;
+      }
+      nodes[i] = moving;
+    }
+
     void percolateDown(int index) {
       int length = nodes.size();
       int i = index, left, right, smallest;
@@ -195,17 +578,17 @@ class PQ {
 	right = 2 * i + 2;
 	smallest = i;
 
-	if (left < length && nodes[left].priority < nodes[smallest].priority) {
+	if (left < length && nodes[left].key < nodes[smallest].key) {
 	  smallest = left;
 	}
-	if (right < length && nodes[right].priority < nodes[smallest].priority) {
+	if (right < length && nodes[right].key < nodes[smallest].key) {
 	  smallest = right;
 	}
 
 	if (smallest != i) {
-	  swap(&nodes[smallest].priority, &nodes[i].priority);
-	  swap(&nodes[smallest].pointer->index, &nodes[i].pointer->index);
-	  swapP(nodes[smallest].pointer, nodes[i].pointer);
+	  swapK(&nodes[smallest].key, &nodes[i].key);
+	  swap(&tree.slotOf(nodes[smallest].handle), &tree.slotOf(nodes[i].handle));
+	  swapP(nodes[smallest].handle, nodes[i].handle);
 	  i = smallest;
 	} 
 	else {
@@ -220,10 +603,10 @@ class PQ {
      
       int parent = floor((i-1)/2);
 
-      while (index > 0 && nodes[index].priority < nodes[parent].priority) {
-          swap(&nodes[index].priority, &nodes[parent].priority);
-          swap(&nodes[index].pointer->index, &nodes[parent].pointer->index);
-          swapP(nodes[index].pointer, nodes[parent].pointer);
+      while (index > 0 && nodes[index].key < nodes[parent].key) {
+          swapK(&nodes[index].key, &nodes[parent].key);
+          swap(&tree.slotOf(nodes[index].handle), &tree.slotOf(nodes[parent].handle));
+          swapP(nodes[index].handle, nodes[parent].handle);
           index = floor((index-1)/2);
           parent = floor((index-1)/2);
       }
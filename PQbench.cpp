@@ -0,0 +1,341 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "PQ.h"
+#include "TaskPool.h"
+#include "ExternalPQ.h"
+#include "BTreeIndex.h"
+#include "DenseIndex.h"
+#include "AsyncPQ.h"
+#include <condition_variable>
+#include <mutex>
+using namespace std;
+
+// Benchmarks for PQ. Run as: ./PQbench [count] [run directory] [index count]
+
+double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void makeInput(int count, vector<int> & ids, vector<int> & priorities) {
+    unsigned int rng = 2024;
+    ids.resize(count);
+    priorities.resize(count);
+    for (int i = 0; i < count; i++) {
+        ids[i] = i;
+        rng = rng * 1103515245 + 12345;
+        priorities[i] = rng >> 1;
+    }
+    for (int i = count - 1; i > 0; i--) {
+        rng = rng * 1103515245 + 12345;
+        swap(ids[i], ids[(rng >> 4) % (i + 1)]);
+    }
+}
+
+void benchBuild(int count) {
+    cout << "------------------ BUILD: " << count << " tasks ------------------" << endl;
+    vector<int> ids, priorities;
+    makeInput(count, ids, priorities);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    double serial;
+    {
+        PQ<int> q(ids, priorities);
+        serial = secondsSince(start);
+    }
+    cout << "serial constructor:        " << serial << " s" << endl;
+
+    // speedup is against the 1-thread pool, so it measures parallelism only;
+    // the pool constructor also uses a different algorithm (bulk-loaded
+    // index, level-by-level heap), which is reported on its own line
+    int hardware = max(1u, thread::hardware_concurrency());
+    double oneThread = 0;
+    for (int threads = 1; threads <= max(hardware, 8); threads *= 2) {
+        TaskPool pool(threads);
+        start = chrono::steady_clock::now();
+        PQ<int> q(ids, priorities, pool);
+        double parallel = secondsSince(start);
+        if (threads == 1) {
+            oneThread = parallel;
+        }
+        cout << "parallel, " << threads << " thread(s):" << string(threads < 10 ? 5 : 4, ' ')
+             << parallel << " s  (speedup " << oneThread / parallel << "x over 1 thread)" << endl;
+    }
+    cout << "pool constructor on 1 thread vs serial constructor: " << serial / oneThread << "x" << endl;
+    cout << "(hardware threads: " << hardware << ")" << endl << endl;
+}
+
+void benchExternal(int count, const string & dir) {
+    int capacity = count / 10;
+    cout << "------------------ EXTERNAL: " << count << " tasks, " << capacity << " in memory (10x) ------------------" << endl;
+    vector<int> ids, priorities;
+    makeInput(count, ids, priorities);
+
+    ExternalPQ<int> q(dir, capacity);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+        q.insert(ids[i], priorities[i]);
+    }
+    double inserted = secondsSince(start);
+    cout << "insert:          " << inserted << " s  (" << count / inserted << " ops/s, " << q.runCount() << " runs)" << endl;
+
+    int updates = count / 10;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < updates; i++) {
+        q.updatePriority(ids[i], priorities[count - 1 - i]);
+    }
+    double updated = secondsSince(start);
+    cout << "updatePriority:  " << updated << " s  (" << updates / updated << " ops/s)" << endl;
+
+    start = chrono::steady_clock::now();
+    while (!q.isEmpty()) {
+        q.deleteMin();
+    }
+    double drained = secondsSince(start);
+    cout << "deleteMin (all): " << drained << " s  (" << count / drained << " ops/s)" << endl;
+
+    start = chrono::steady_clock::now();
+    {
+        PQ<int> memory;
+        for (int i = 0; i < count; i++) {
+            memory.insert(ids[i], priorities[i]);
+        }
+        while (!memory.isEmpty()) {
+            memory.deleteMin();
+        }
+    }
+    cout << "in-memory PQ insert + drain, for comparison: " << secondsSince(start) << " s" << endl << endl;
+}
+
+template <typename Index>
+void benchIndexWith(const char * name, const vector<int> & ids, const vector<int> & priorities) {
+    int count = ids.size();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    {
+        Index index;
+        for (int i = 0; i < count; i++) {
+            index.insert(ids[i], i);
+        }
+        double inserted = secondsSince(start);
+
+        start = chrono::steady_clock::now();
+        long long sum = 0;
+        for (int i = count - 1; i >= 0; i--) {
+            sum += index.findIndex(ids[i]);
+        }
+        double found = secondsSince(start);
+        cout << name << " insert:    " << inserted << " s  (" << count / inserted << " ops/s)" << endl;
+        cout << name << " findIndex: " << found << " s  (" << count / found << " ops/s, checksum " << sum << ")" << endl;
+    }
+
+    start = chrono::steady_clock::now();
+    {
+        PQ<int, int, Index> q;
+        for (int i = 0; i < count; i++) {
+            q.insert(ids[i], priorities[i]);
+        }
+        for (int i = 0; i < count; i++) {
+            q.updatePriority(ids[i], priorities[count - 1 - i]);
+        }
+    }
+    cout << name << " PQ insert + updatePriority: " << secondsSince(start) << " s" << endl;
+}
+
+void benchIndex(int count) {
+    cout << "------------------ INDEX: " << count << " IDs, AvlTree vs BTreeIndex vs DenseIndex ------------------" << endl;
+    vector<int> ids, priorities;
+    makeInput(count, ids, priorities);
+    benchIndexWith<AvlTree<int>>("AvlTree   ", ids, priorities);
+    benchIndexWith<BTreeIndex<int>>("BTreeIndex", ids, priorities);
+    benchIndexWith<DenseIndex<int>>("DenseIndex", ids, priorities);
+    cout << endl;
+}
+
+// A one-thread executor for AsyncPQ: resumes posted coroutine handles on
+// its own thread, sleeping on a condition variable while it has none, and
+// reports when it is idle so the benchmark can start the next round
+class ResumeThread {
+
+  public:
+
+    ResumeThread() : idle(false), stopping(false), worker([this] { run(); }) {}
+
+    ~ResumeThread() {
+      {
+        lock_guard<mutex> lock(m);
+        stopping = true;
+      }
+      ready.notify_one();
+      worker.join();
+    }
+
+    void post( coroutine_handle<> h ) {
+      {
+        lock_guard<mutex> lock(m);
+        handles.push_back(h);
+      }
+      ready.notify_one();
+    }
+
+    // Block until the thread is waiting for work and done(), read under the
+    // thread's lock, returns true
+    template <typename F>
+    void waitIdle( F done ) {
+      unique_lock<mutex> lock(m);
+      becameIdle.wait(lock, [this, &done] { return idle && done(); });
+    }
+
+  private:
+
+    mutex m;
+    condition_variable ready, becameIdle;
+    vector<coroutine_handle<>> handles;
+    bool idle, stopping;
+    thread worker;
+
+    void run() {
+      unique_lock<mutex> lock(m);
+      while (true) {
+        while (handles.empty() && !stopping) {
+          idle = true;
+          becameIdle.notify_one();
+          ready.wait(lock);
+        }
+        if (handles.empty()) {
+          return;
+        }
+        idle = false;
+        coroutine_handle<> h = handles.back();
+        handles.pop_back();
+        lock.unlock();
+        h.resume();
+        lock.lock();
+      }
+    }
+};
+
+DetachedTask timeWakeups(AsyncPQ<int> & q, const vector<chrono::steady_clock::time_point> & stamps,
+                         double & total, int & received) {
+    try {
+        while (true) {
+            int x = co_await q.pop();
+            total += secondsSince(stamps[x]);
+            received++;
+        }
+    }
+    catch (UnderflowException &) {
+    }
+}
+
+// Each round inserts one task while the consumer sleeps, and times how long
+// the task takes to reach it. The two main figures take the same path: a
+// coroutine suspended in AsyncPQ::pop and resumed on a consumer thread by
+// a ResumeThread executor, against a thread blocked on a condition variable
+// in a PQ loop. Each round waits until the consumer is asleep again. The
+// last figure is AsyncPQ's default, resuming the coroutine inline on the
+// inserting thread, with no thread switch; it is not comparable to the others.
+void benchWakeup(int rounds) {
+    cout << "------------------ WAKEUP: " << rounds << " rounds, AsyncPQ vs condition variable ------------------" << endl;
+    vector<chrono::steady_clock::time_point> stamps(rounds);
+
+    double asyncTotal = 0;
+    int received = 0;
+    {
+        ResumeThread consumer;
+        AsyncPQ<int> q([&consumer](coroutine_handle<> h) { consumer.post(h); });
+        timeWakeups(q, stamps, asyncTotal, received);
+        for (int i = 0; i < rounds; i++) {
+            consumer.waitIdle([&received, i] { return received == i; });
+            stamps[i] = chrono::steady_clock::now();
+            q.insert(i, 0);
+        }
+        consumer.waitIdle([&received, rounds] { return received == rounds; });
+        q.shutdown();
+    }
+    cout << "co_await pop, resumed on a consumer thread:  " << asyncTotal / received * 1e6 << " us per wakeup" << endl;
+
+    PQ<int> queue;
+    mutex m;
+    condition_variable ready, consumed;
+    double cvTotal = 0;
+    int done = 0;
+    bool idle = false;
+    thread consumer([&] {
+        unique_lock<mutex> lock(m);
+        for (int i = 0; i < rounds; i++) {
+            while (queue.isEmpty()) {
+                idle = true;
+                consumed.notify_one();
+                ready.wait(lock);
+            }
+            idle = false;
+            int x = queue.deleteMin();
+            cvTotal += secondsSince(stamps[x]);
+            done++;
+        }
+    });
+    for (int i = 0; i < rounds; i++) {
+        unique_lock<mutex> lock(m);
+        // one task in flight at a time: wait until the consumer is asleep again
+        consumed.wait(lock, [&done, &idle, i] { return idle && done == i; });
+        stamps[i] = chrono::steady_clock::now();
+        queue.insert(i, 0);
+        ready.notify_one();
+    }
+    consumer.join();
+    cout << "condition variable, blocked consumer thread: " << cvTotal / rounds * 1e6 << " us per wakeup" << endl;
+
+    AsyncPQ<int> inlineQ;
+    double inlineTotal = 0;
+    int inlineReceived = 0;
+    timeWakeups(inlineQ, stamps, inlineTotal, inlineReceived);
+    for (int i = 0; i < rounds; i++) {
+        stamps[i] = chrono::steady_clock::now();
+        inlineQ.insert(i, 0);
+    }
+    inlineQ.shutdown();
+    cout << "(co_await pop, resumed inline by insert:     " << inlineTotal / inlineReceived * 1e6
+         << " us per hand-off, no thread switch)" << endl << endl;
+}
+
+// Lowers every priority by 1 per round: with ageAll, and with one
+// updatePriority per task as callers had to before
+void benchAging(int count) {
+    int rounds = 100;
+    cout << "------------------ AGING: " << count << " tasks, " << rounds << " rounds ------------------" << endl;
+    vector<int> ids, priorities;
+    makeInput(count, ids, priorities);
+
+    PQ<int> aged(ids, priorities);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        aged.ageAll(1);
+    }
+    cout << "ageAll:                  " << secondsSince(start) / rounds * 1e6 << " us per round" << endl;
+
+    PQ<int> updated(ids, priorities);
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < count; i++) {
+            updated.updatePriority(ids[i], priorities[i] - r - 1);
+        }
+    }
+    cout << "updatePriority per task: " << secondsSince(start) / rounds * 1e6 << " us per round" << endl;
+    cout << "minimum priorities agree: " << (aged.findMinPriority() == updated.findMinPriority() ? "yes" : "no") << endl << endl;
+}
+
+int main(int argc, char ** argv) {
+    int count = argc > 1 ? atoi(argv[1]) : 2000000;
+    string dir = argc > 2 ? argv[2] : ".";
+    int indexCount = argc > 3 ? atoi(argv[3]) : 10000000;
+
+    benchBuild(count);
+    benchExternal(count, dir);
+    benchIndex(indexCount);
+    benchWakeup(100000);
+    benchAging(count / 10);
+
+    return 0;
+}
@@ -4,8 +4,25 @@
 #include <vector>
 #include "PQ.h"
 #include "AvlTree.h"
+#include "TimerQueue.h"
+#include "WheelPQ.h"
+#include "TaskPool.h"
+#include "ExternalPQ.h"
+#include "FixedPQ.h"
+#include "BTreeIndex.h"
+#include "DenseIndex.h"
+#include "AsyncPQ.h"
+#include "AgingPQ.h"
+#include <climits>
+#include <ctime>
+#include <cstdint>
+#include <mutex>
+#include <thread>
 using namespace std;
 
+// Task IDs of this type are dense, so PQ<uint32_t> uses a DenseIndex
+template <> struct IDUniverse<uint32_t> { static constexpr long long size = 50000; };
+
 void testHeapify() {
     cout << "------------------ START TEST MAKE-HEAP ------------------ " << endl << endl;
 
@@ -170,6 +187,869 @@ void testEverything() {
     cout << endl << "------------------ END TEST EVERYTHING ------------------ " << endl << endl;
 }
 
+void testStableFIFO() {
+    cout << "------------------ START TEST STABLE FIFO ------------------ " << endl << endl;
+
+    const int COUNT = 1000000;
+    const int LEVELS = 5;
+    cout << "Inserting " << COUNT << " IDs in increasing order across " << LEVELS << " priority levels..." << endl;
+
+    PQ<int> q(true);
+    for (int i = 0; i < COUNT; i++) {
+        q.insert(i, (i * 7) % LEVELS);
+    }
+
+    cout << "Updating every 10th ID to priority 0 (moves it to the back of level 0)..." << endl;
+    for (int i = 0; i < COUNT; i += 10) {
+        q.updatePriority(i, 0);
+    }
+
+    cout << "Deleting all mins and checking FIFO order within each level..." << endl << endl;
+    // Within level 0, IDs never updated come first in insertion order,
+    // followed by the updated ones in update order.
+    bool ordered = true;
+    int popped = 0, lastLevel = -1, lastID = -1;
+    bool inUpdated = false;
+    while (!q.isEmpty()) {
+        int id = q.deleteMin();
+        int level = (id % 10 == 0) ? 0 : (id * 7) % LEVELS;
+        bool updated = (id % 10 == 0);
+        if (level != lastLevel) {
+            ordered = ordered && level > lastLevel;
+            lastLevel = level;
+            lastID = -1;
+            inUpdated = false;
+        }
+        if (level == 0 && updated && !inUpdated) {
+            inUpdated = true;
+            lastID = -1;
+        }
+        ordered = ordered && id > lastID && (updated || !inUpdated || level != 0);
+        lastID = id;
+        popped++;
+    }
+
+    cout << "IDs removed: " << popped << endl;
+    cout << "FIFO order within priority levels: " << (ordered && popped == COUNT ? "PASS" : "FAIL") << endl;
+
+    cout << endl << "------------------ END TEST STABLE FIFO ------------------ " << endl << endl;
+}
+
+void testMerge() {
+    cout << "------------------ START TEST MERGE ------------------ " << endl << endl;
+    cout << "Queue A: IDs 111-555 with priorities 10,8,6,4,2" << endl;
+    cout << "Queue B: IDs 666-1110 with priorities 9,7,5,3,1" << endl << endl;
+
+    PQ<int> a, b;
+    for (int i = 1; i <= 5; i++) {
+        a.insert(i*111, 12 - 2*i);
+        b.insert((i+5)*111, 11 - 2*i);
+    }
+    cout << "Merging B into A (disjoint IDs, AVL trees are joined)..." << endl << endl;
+    a.merge(std::move(b));
+    a.display();
+    cout << endl << "B is now empty: " << (b.isEmpty() ? "yes" : "no") << endl << endl;
+
+    const int COUNT = 200000;
+    cout << "Merging two queues of " << COUNT << " interleaved IDs, " << COUNT / 4 << " in both..." << endl;
+    // priority of ID i is (i * 37) % 1000 in c, and (i * 37) % 1000 + 1 in d;
+    // IDs in both queues must take d's priority
+    PQ<int> c, d;
+    for (int i = 0; i < COUNT; i++) {
+        c.insert(2*i, (2*i * 37) % 1000);
+        if (i % 2 == 0) {
+            d.insert(2*i, (2*i * 37) % 1000 + 1);
+        }
+        d.insert(2*i + 1, ((2*i + 1) * 37) % 1000 + 1);
+    }
+    c.merge(std::move(d));
+
+    bool ordered = true;
+    int expectedSize = COUNT * 2;
+    int actualSize = c.size();
+    int lastPriority = -1;
+    while (!c.isEmpty()) {
+        int id = c.deleteMin();
+        bool fromD = (id % 2 == 1) || (id % 4 == 0);
+        int priority = (id * 37) % 1000 + (fromD ? 1 : 0);
+        ordered = ordered && priority >= lastPriority;
+        lastPriority = priority;
+    }
+    cout << "Merged size: " << actualSize << " (expected " << expectedSize << ")" << endl;
+    cout << "Merged queue drains in priority order: " << (ordered && actualSize == expectedSize ? "PASS" : "FAIL") << endl;
+
+    cout << endl << "------------------ END TEST MERGE ------------------ " << endl << endl;
+}
+
+void testSplit() {
+    cout << "------------------ START TEST SPLIT ------------------ " << endl << endl;
+    cout << "Inserting values from 10-1..." << endl;
+
+    PQ<int> q;
+    for (int i = 10; i > 0; i--) {
+        q.insert(i*111, i);
+    }
+    cout << "Splitting at ID 600..." << endl << endl;
+    PQ<int> upper = q.splitByID(600);
+    cout << "Lower queue (IDs < 600):" << endl;
+    q.display();
+    cout << endl << "Upper queue (IDs >= 600):" << endl;
+    upper.display();
+
+    const int COUNT = 200000;
+    const int PIVOT = COUNT / 3;
+    cout << endl << "Splitting a queue of " << COUNT << " IDs at " << PIVOT << "..." << endl;
+    PQ<int> big;
+    for (int i = 0; i < COUNT; i++) {
+        big.insert(i, (i * 7919) % 1000);
+    }
+    PQ<int> bigUpper = big.splitByID(PIVOT);
+
+    bool correct = big.size() == PIVOT && bigUpper.size() == COUNT - PIVOT;
+    int lastPriority = -1;
+    while (!big.isEmpty()) {
+        int id = big.deleteMin();
+        correct = correct && id < PIVOT && (id * 7919) % 1000 >= lastPriority;
+        lastPriority = (id * 7919) % 1000;
+    }
+    lastPriority = -1;
+    while (!bigUpper.isEmpty()) {
+        int id = bigUpper.deleteMin();
+        correct = correct && id >= PIVOT && (id * 7919) % 1000 >= lastPriority;
+        lastPriority = (id * 7919) % 1000;
+    }
+    cout << "Both halves hold the right IDs in priority order: " << (correct ? "PASS" : "FAIL") << endl;
+
+    cout << endl << "------------------ END TEST SPLIT ------------------ " << endl << endl;
+}
+
+void testTimerQueue() {
+    cout << "------------------ START TEST TIMER QUEUE ------------------ " << endl << endl;
+
+    long long base = 1700000000000LL;  // a 64-bit epoch-millis deadline
+    cout << "Scheduling IDs 1-5 at base+500, base+100, base+300, base+100, base+5000..." << endl;
+    TimerQueue<int> timers;
+    timers.schedule(1, base + 500);
+    timers.schedule(2, base + 100);
+    timers.schedule(3, base + 300);
+    timers.schedule(4, base + 100);
+    timers.schedule(5, base + 5000);
+    cout << "Rescheduling ID 3 to base+50 and cancelling ID 1..." << endl;
+    timers.schedule(3, base + 50);
+    timers.cancel(1);
+
+    cout << "Next deadline: base+" << timers.nextDeadline() - base << endl;
+    vector<int> due;
+    int count = timers.popExpired(base + 1000, due);
+    cout << "Due at base+1000 (" << count << "):";
+    for (size_t i = 0; i < due.size(); i++) {
+        cout << " " << due[i];
+    }
+    cout << endl;
+    bool correct = count == 3 && due[0] == 3 && due[1] == 2 && due[2] == 4
+                   && timers.size() == 1 && timers.nextDeadline() == base + 5000;
+    cout << "Expiry sweep returns due IDs in deadline order: " << (correct ? "PASS" : "FAIL") << endl << endl;
+
+    cout << "Two worker threads wait on 3 timers due in 30-90ms..." << endl;
+    TimerQueue<int> live;
+    vector<int> popped;
+    mutex poppedLock;
+    bool early = false;
+    long long start = TimerQueue<int>::now();
+    auto worker = [&]() {
+        int id;
+        while (live.waitPop(id)) {
+            lock_guard<mutex> lock(poppedLock);
+            early = early || TimerQueue<int>::now() < start + id;
+            popped.push_back(id);
+        }
+    };
+    thread w1(worker), w2(worker);
+    live.schedule(90, start + 90);
+    live.schedule(30, start + 30);
+    live.schedule(60, start + 60);
+    this_thread::sleep_for(chrono::milliseconds(200));
+    live.shutdown();
+    w1.join();
+    w2.join();
+
+    cout << "Timers popped:";
+    for (size_t i = 0; i < popped.size(); i++) {
+        cout << " " << popped[i];
+    }
+    cout << endl;
+    correct = popped.size() == 3 && popped[0] == 30 && popped[1] == 60 && popped[2] == 90 && !early;
+    cout << "Workers sleep until each deadline: " << (correct ? "PASS" : "FAIL") << endl;
+
+    cout << "A worker waits on a timer that never comes due (deadline LLONG_MAX), then shuts down..." << endl;
+    TimerQueue<int> never;
+    never.schedule(1, LLONG_MAX);
+    int woke = 0;
+    thread sleeper([&]() {
+        int id;
+        while (never.waitPop(id)) {
+            woke++;
+        }
+    });
+    this_thread::sleep_for(chrono::milliseconds(10));
+    clock_t cpu = clock();   // process CPU time: a worker that spins instead of sleeping shows up here
+    this_thread::sleep_for(chrono::milliseconds(100));
+    bool slept = clock() - cpu < CLOCKS_PER_SEC / 50;
+    start = TimerQueue<int>::now();
+    never.shutdown();
+    sleeper.join();
+    correct = slept && woke == 0 && never.size() == 1 && TimerQueue<int>::now() - start < 1000;
+    cout << "Far deadline neither fires nor blocks shutdown: " << (correct ? "PASS" : "FAIL") << endl;
+
+    cout << endl << "------------------ END TEST TIMER QUEUE ------------------ " << endl << endl;
+}
+
+void testWheelPQ() {
+    cout << "------------------ START TEST WHEEL PQ ------------------ " << endl << endl;
+
+    cout << "Wheel of 1024 slots starting at 0; inserting IDs at 5, 5, 2, 3000 (spills), -4 (late)..." << endl;
+    WheelPQ<int> w(1024, 0);
+    w.insert(1, 5);
+    w.insert(2, 5);
+    w.insert(3, 2);
+    w.insert(4, 3000);
+    w.insert(5, -4);
+    cout << "Size: " << w.size() << "  Outside the wheel: " << w.spilled() << endl;
+    cout << "Updating ID 4 to priority 1 (pulls it into the wheel)..." << endl;
+    w.updatePriority(4, 1);
+    cout << "Outside the wheel: " << w.spilled() << endl;
+    cout << "Deleting all mins:";
+    while (!w.isEmpty()) {
+        cout << " " << w.deleteMin();
+    }
+    cout << endl << endl;
+
+    cout << "Wheel of 64 slots; IDs at 100 and 5000 spill, advancing to 1000 then inserting at 1010..." << endl;
+    WheelPQ<int> jump(64, 0);
+    jump.insert(1, 100);
+    jump.insert(2, 5000);
+    jump.advance(1000);
+    jump.insert(3, 1010);
+    bool held = jump.now() == 100 && jump.findMinPriority() == 100 && jump.deleteMin() == 1
+                && jump.deleteMin() == 3 && jump.deleteMin() == 2;
+    cout << "advance stops at the earliest spilled priority: " << (held ? "PASS" : "FAIL") << endl << endl;
+
+    cout << "Wheel of 64 slots starting at -2^62; inserting IDs at LLONG_MAX, LLONG_MIN and the cursor..." << endl;
+    // LLONG_MAX - cursor overflows a long long; the task must still spill far
+    WheelPQ<int> extreme(64, LLONG_MIN / 2);
+    extreme.insert(1, LLONG_MAX);
+    extreme.insert(2, LLONG_MIN);
+    extreme.insert(3, LLONG_MIN / 2);
+    bool extremes = extreme.spilled() == 2 && extreme.deleteMin() == 2 && extreme.deleteMin() == 3
+                    && extreme.deleteMin() == 1 && extreme.isEmpty();
+    cout << "Extreme priorities are filed outside the wheel and leave in order: " << (extremes ? "PASS" : "FAIL") << endl << endl;
+
+    const int OPS = 300000;
+    cout << "Running " << OPS << " mixed operations against a PQ<int, long long>..." << endl;
+    // mostly near-term priorities, some far-future ones, occasional reprioritization
+    // and jumps of the window
+    PQ<int, long long> reference;
+    WheelPQ<int> wheel(256, 0);
+    unsigned int rng = 12345;
+    bool agree = true;
+    long long now = 0;
+    int nextID = 0;
+    for (int i = 0; i < OPS && agree; i++) {
+        rng = rng * 1103515245 + 12345;
+        int op = (rng >> 16) % 10;
+        if (op < 5 || reference.isEmpty()) {
+            rng = rng * 1103515245 + 12345;
+            long long delay = (op == 0) ? (rng >> 8) % 100000 : (rng >> 8) % 3000;
+            reference.insert(nextID, now + delay);
+            wheel.insert(nextID, now + delay);
+            nextID++;
+        }
+        else if (op < 7) {
+            rng = rng * 1103515245 + 12345;
+            int id = (rng >> 8) % nextID;
+            long long p = now + (rng >> 4) % 5000 - 50;
+            reference.updatePriority(id, p);
+            wheel.updatePriority(id, p);
+        }
+        else if (op == 9) {
+            rng = rng * 1103515245 + 12345;
+            wheel.advance(now + (rng >> 8) % 200000);
+            now = wheel.now();
+        }
+        else {
+            long long p = reference.findMinPriority();
+            agree = wheel.findMinPriority() == p;
+            int id = wheel.deleteMin();
+            agree = agree && reference.contains(id);
+            reference.remove(id);
+            now = p;
+        }
+        agree = agree && wheel.size() == reference.size();
+    }
+    while (agree && !reference.isEmpty()) {
+        agree = wheel.findMinPriority() == reference.findMinPriority();
+        reference.remove(wheel.deleteMin());
+    }
+    cout << "Wheel removes IDs in the same priority order: " << (agree && wheel.isEmpty() ? "PASS" : "FAIL") << endl;
+
+    cout << endl << "------------------ END TEST WHEEL PQ ------------------ " << endl << endl;
+}
+
+void testParallelBuild() {
+    cout << "------------------ START TEST PARALLEL BUILD ------------------ " << endl << endl;
+
+    TaskPool pool(4);
+    cout << "Initializing priorities 10-1 and arbitrary IDs on a pool of " << pool.size() << " threads..." << endl << endl;
+    vector<int> priorities;
+    for (int i = 10; i > 0; i--) {
+        priorities.push_back(i);
+    }
+    vector<int> ids;
+    for (int j = 10; j > 0; j--) {
+        ids.push_back(j*111);
+    }
+    PQ<int> q(ids, priorities, pool);
+    q.display();
+
+    const int COUNT = 500000;
+    cout << endl << "Building a queue of " << COUNT << " shuffled IDs in parallel..." << endl;
+    vector<int> bigIDs, bigPriorities;
+    unsigned int rng = 99;
+    for (int i = 0; i < COUNT; i++) {
+        bigIDs.push_back(i);
+        rng = rng * 1103515245 + 12345;
+        bigPriorities.push_back((rng >> 8) % 100000);
+    }
+    for (int i = COUNT - 1; i > 0; i--) {
+        rng = rng * 1103515245 + 12345;
+        int j = (rng >> 4) % (i + 1);
+        swap(bigIDs[i], bigIDs[j]);
+        swap(bigPriorities[i], bigPriorities[j]);
+    }
+    vector<int> priorityOfID(COUNT);
+    for (int i = 0; i < COUNT; i++) {
+        priorityOfID[bigIDs[i]] = bigPriorities[i];
+    }
+    PQ<int> big(bigIDs, bigPriorities, pool);
+
+    bool correct = big.size() == COUNT;
+    for (int i = 0; i < COUNT; i += 997) {
+        correct = correct && big.contains(i);
+    }
+    big.updatePriority(COUNT / 2, -1);
+    correct = correct && big.findMin() == COUNT / 2;
+    int lastPriority = -1, popped = 0;
+    big.deleteMin();
+    while (!big.isEmpty()) {
+        int id = big.deleteMin();
+        correct = correct && priorityOfID[id] >= lastPriority;
+        lastPriority = priorityOfID[id];
+        popped++;
+    }
+    cout << "Parallel-built queue holds every ID and drains in priority order: "
+         << (correct && popped == COUNT - 1 ? "PASS" : "FAIL") << endl;
+
+    cout << "Building from a list with a duplicate ID..." << endl;
+    ids.push_back(555);
+    priorities.push_back(0);
+    bool threw = false;
+    try {
+        PQ<int> dup(ids, priorities, pool);
+    }
+    catch (const IllegalArgumentException &) {
+        threw = true;
+    }
+    cout << "Duplicate IDs rejected with IllegalArgumentException: " << (threw ? "PASS" : "FAIL") << endl;
+
+    cout << endl << "------------------ END TEST PARALLEL BUILD ------------------ " << endl << endl;
+}
+
+void testExternalPQ() {
+    cout << "------------------ START TEST EXTERNAL PQ ------------------ " << endl << endl;
+
+    const int COUNT = 100000;
+    const int CAPACITY = 1000;
+    cout << "Inserting " << COUNT << " IDs with " << CAPACITY << " kept in memory (runs spill to the current directory)..." << endl;
+    ExternalPQ<int> q(".", CAPACITY);
+    PQ<int> reference;
+    vector<int> priorityOf(COUNT);
+    unsigned int rng = 7;
+    for (int i = 0; i < COUNT; i++) {
+        rng = rng * 1103515245 + 12345;
+        int p = (rng >> 8) % 1000000;
+        q.insert(i, p);
+        reference.insert(i, p);
+        priorityOf[i] = p;
+    }
+    cout << "Size: " << q.size() << "  Run files: " << q.runCount() << endl;
+
+    cout << "Updating " << COUNT / 10 << " IDs and removing " << COUNT / 20 << " (older copies become stale)..." << endl;
+    for (int i = 0; i < COUNT / 10; i++) {
+        rng = rng * 1103515245 + 12345;
+        int id = (rng >> 8) % COUNT;
+        rng = rng * 1103515245 + 12345;
+        int p = (rng >> 8) % 1000000;
+        q.updatePriority(id, p);
+        reference.updatePriority(id, p);
+        priorityOf[id] = p;
+    }
+    for (int i = 0; i < COUNT / 20; i++) {
+        rng = rng * 1103515245 + 12345;
+        int id = (rng >> 8) % COUNT;
+        q.remove(id);
+        reference.remove(id);
+    }
+
+    bool agree = q.size() == reference.size();
+    cout << "Size after updates: " << q.size() << " (expected " << reference.size() << ")" << endl;
+
+    cout << "Deleting mins while deferring or removing the current minimum in between..." << endl;
+    // the minimum is often a run head whose index check is cached, and the
+    // update or removal must invalidate that cached check
+    for (int i = 0; i < 20000 && agree; i++) {
+        int id = q.findMin();
+        int p = reference.findMinPriority();
+        agree = reference.contains(id) && priorityOf[id] == p;
+        rng = rng * 1103515245 + 12345;
+        int op = (rng >> 8) % 3;
+        if (op == 0) {
+            int later = p + 1 + (rng >> 12) % 1000;
+            q.updatePriority(id, later);
+            reference.updatePriority(id, later);
+            priorityOf[id] = later;
+        }
+        else if (op == 1) {
+            q.remove(id);
+            reference.remove(id);
+        }
+        else {
+            agree = agree && q.deleteMin() == id;
+            reference.remove(id);
+        }
+        agree = agree && q.size() == reference.size();
+    }
+
+    cout << "Deleting all mins and comparing with an in-memory PQ..." << endl;
+    while (agree && !reference.isEmpty()) {
+        int p = reference.findMinPriority();
+        int id = q.deleteMin();
+        agree = reference.contains(id);
+        reference.remove(id);
+        // IDs of equal priority may come out in either order
+        agree = agree && (reference.isEmpty() || reference.findMinPriority() >= p);
+    }
+    cout << "External queue drains in priority order: " << (agree && q.isEmpty() ? "PASS" : "FAIL") << endl;
+
+    cout << endl << "------------------ END TEST EXTERNAL PQ ------------------ " << endl << endl;
+}
+
+void testFixedPQ() {
+    cout << "------------------ START TEST FIXED PQ ------------------ " << endl << endl;
+
+    constexpr FixedPQ<int, 16> blank;
+    static_assert(blank.isEmpty() && blank.capacity() == 16, "FixedPQ is constexpr-constructible");
+    cout << "Constructed a FixedPQ<int, 16> at compile time" << endl;
+
+    cout << "Inserting values from 20-1 into a FixedPQ<int, 16>..." << endl;
+    FixedPQ<int, 16> q;
+    int full = 0;
+    for (int i = 20; i > 0; i--) {
+        if (q.insert(i*111, i) == PQStatus::Full) {
+            full++;
+        }
+    }
+    cout << "Size: " << q.size() << "  Inserts refused as Full: " << full << endl;
+    cout << "Inserting ID 555 again returns Duplicate: " << (q.insert(555, 1) == PQStatus::Duplicate ? "yes" : "no") << endl;
+    cout << "Updating ID 2220 to priority 0 and removing ID 1110..." << endl;
+    q.updatePriority(2220, 0);
+    q.remove(1110);
+    cout << "Deleting all mins:";
+    int id;
+    while (q.deleteMin(id) == PQStatus::Ok) {
+        cout << " " << id;
+    }
+    cout << endl;
+    cout << "deleteMin on an empty queue returns Empty: " << (q.deleteMin(id) == PQStatus::Empty ? "yes" : "no") << endl << endl;
+
+    const int OPS = 200000;
+    cout << "Running " << OPS << " mixed operations on a FixedPQ<int, 1000> against a PQ<int>..." << endl;
+    static FixedPQ<int, 1000> fixed;
+    PQ<int> reference;
+    vector<int> priorityOfID(1500);
+    unsigned int rng = 4242;
+    bool agree = true;
+    for (int i = 0; i < OPS && agree; i++) {
+        rng = rng * 1103515245 + 12345;
+        int op = (rng >> 16) % 4;
+        rng = rng * 1103515245 + 12345;
+        int x = (rng >> 8) % 1500;
+        int p = (rng >> 4) % 100000;
+        if (op == 0) {
+            PQStatus s = fixed.updatePriority(x, p);
+            agree = (s == PQStatus::Full) == (!reference.contains(x) && reference.size() == 1000);
+            if (s == PQStatus::Ok) {
+                reference.updatePriority(x, p);
+                priorityOfID[x] = p;
+            }
+        }
+        else if (op == 1) {
+            agree = (fixed.remove(x) == PQStatus::Ok) == reference.contains(x);
+            reference.remove(x);
+        }
+        else if (op == 2 && !reference.isEmpty()) {
+            int minPriority = reference.findMinPriority();
+            // IDs of equal priority may come out in either order
+            agree = fixed.deleteMin(id) == PQStatus::Ok && reference.contains(id)
+                    && priorityOfID[id] == minPriority;
+            reference.remove(id);
+        }
+        else {
+            PQStatus s = fixed.insert(x, p);
+            if (s == PQStatus::Ok) {
+                reference.insert(x, p);
+                priorityOfID[x] = p;
+            }
+            agree = (s == PQStatus::Duplicate) == reference.contains(x) || s == PQStatus::Ok;
+        }
+        agree = agree && fixed.size() == reference.size();
+    }
+    cout << "Fixed-capacity queue matches the reference: " << (agree ? "PASS" : "FAIL") << endl;
+
+    cout << endl << "------------------ END TEST FIXED PQ ------------------ " << endl << endl;
+}
+
+// Runs mixed operations, then a merge and a split, on a stable PQ with the
+// given index and on a stable PQ<int>, and checks that the two agree
+template <typename ID, typename Index>
+void testIndex(const string & name, unsigned int rng) {
+    const int OPS = 300000;
+    cout << "Running " << OPS << " mixed operations on a stable " << name << " against a stable PQ<int>..." << endl;
+    PQ<ID, int, Index> indexed(true);
+    PQ<int> avl(true);
+    bool agree = true;
+    for (int i = 0; i < OPS && agree; i++) {
+        rng = rng * 1103515245 + 12345;
+        int op = (rng >> 16) % 4;
+        rng = rng * 1103515245 + 12345;
+        int x = (rng >> 8) % 20000;
+        int p = (rng >> 4) % 1000;
+        if (op == 0) {
+            indexed.updatePriority(x, p);
+            avl.updatePriority(x, p);
+        }
+        else if (op == 1) {
+            indexed.remove(x);
+            avl.remove(x);
+        }
+        else if (op == 2 && !avl.isEmpty()) {
+            agree = (int) indexed.deleteMin() == avl.deleteMin();
+        }
+        else if (!avl.contains(x)) {
+            indexed.insert(x, p);
+            avl.insert(x, p);
+        }
+        agree = agree && indexed.size() == avl.size() && indexed.contains(x) == avl.contains(x);
+    }
+    cout << "Queues agree on every operation: " << (agree ? "PASS" : "FAIL") << endl << endl;
+
+    cout << "Merging in an overlapping queue, then splitting at ID 10000..." << endl;
+    PQ<ID, int, Index> indexedOther(true);
+    PQ<int> avlOther(true);
+    for (int x = 5000; x < 25000; x += 3) {
+        indexedOther.insert(x, x % 500);
+        avlOther.insert(x, x % 500);
+    }
+    indexed.merge(std::move(indexedOther));
+    avl.merge(std::move(avlOther));
+    PQ<ID, int, Index> indexedUpper = indexed.splitByID(10000);
+    PQ<int> avlUpper = avl.splitByID(10000);
+    agree = indexed.size() == avl.size() && indexedUpper.size() == avlUpper.size();
+    while (agree && !avl.isEmpty()) {
+        agree = (int) indexed.deleteMin() == avl.deleteMin();
+    }
+    while (agree && !avlUpper.isEmpty()) {
+        agree = (int) indexedUpper.deleteMin() == avlUpper.deleteMin();
+    }
+    cout << "Merged and split queues agree: " << (agree ? "PASS" : "FAIL") << endl << endl;
+}
+
+void testBTreeIndex() {
+    cout << "------------------ START TEST B-TREE INDEX ------------------ " << endl << endl;
+
+    cout << "Inserting IDs 1-100 into a BTreeIndex<int>..." << endl;
+    BTreeIndex<int> index;
+    for (int i = 100; i > 0; i--) {
+        index.insert(i, i * 2);
+    }
+    for (int i = 1; i <= 100; i += 2) {
+        index.remove(i);
+    }
+    bool indexOK = index.size() == 50 && index.findMin() == 2 && index.findMax() == 100
+                   && index.findIndex(64) == 128 && index.findIndex(63) == -1 && !index.contains(1);
+    cout << "Odd IDs removed; min, max and back-links: " << (indexOK ? "PASS" : "FAIL") << endl << endl;
+
+    testIndex<int, BTreeIndex<int>>("PQ<int, int, BTreeIndex<int>>", 777);
+
+    cout << "Building a PQ<int, int, BTreeIndex<int>> of 100000 tasks on a 4-thread pool..." << endl;
+    TaskPool pool(4);
+    vector<int> tasks, priorities;
+    for (int i = 0; i < 100000; i++) {
+        tasks.push_back((i * 7919) % 100000);
+        priorities.push_back((i * 31) % 1000);
+    }
+    PQ<int, int, BTreeIndex<int>> built(tasks, priorities, pool, true);
+    PQ<int> reference(tasks, priorities, true);
+    bool agree = built.size() == reference.size();
+    while (agree && !reference.isEmpty()) {
+        agree = built.deleteMin() == reference.deleteMin();
+    }
+    cout << "Parallel-built queue drains like the serial AvlTree one: " << (agree ? "PASS" : "FAIL") << endl;
+
+    cout << endl << "------------------ END TEST B-TREE INDEX ------------------ " << endl << endl;
+}
+
+void testDenseIndex() {
+    cout << "------------------ START TEST DENSE INDEX ------------------ " << endl << endl;
+
+    bool selected = is_same<PQIndexFor<uint32_t>::type, DenseIndex<uint32_t>>::value
+                    && is_same<PQIndexFor<int>::type, AvlTree<int>>::value;
+    cout << "PQ<uint32_t> picks DenseIndex, PQ<int> keeps AvlTree: " << (selected ? "PASS" : "FAIL") << endl << endl;
+
+    testIndex<uint32_t, DenseIndex<uint32_t>>("PQ<uint32_t>", 31337);
+
+    cout << "Filling a PQ<uint32_t> with IDs 0-999, emptying it, then reinserting IDs 10-19..." << endl;
+    PQ<uint32_t> refill;
+    for (int x = 0; x < 1000; x++) {
+        refill.insert(x, x % 7);
+    }
+    refill.makeEmpty();
+    bool emptied = refill.isEmpty() && !refill.contains(0) && !refill.contains(999);
+    for (int x = 19; x >= 10; x--) {
+        refill.insert(x, x);
+    }
+    bool refilled = refill.size() == 10 && refill.contains(15) && !refill.contains(5);
+    for (int x = 10; x < 20 && refilled; x++) {
+        refilled = refill.deleteMin() == (uint32_t) x;
+    }
+    cout << "Emptying clears every ID, and the queue refills cleanly: "
+         << (emptied && refilled && refill.isEmpty() ? "PASS" : "FAIL") << endl << endl;
+
+    cout << "Building an explicit PQ<int, int, DenseIndex<int>> from 10 tasks, with a repeat and an ID outside the universe..." << endl;
+    vector<int> tasks = {9, 3, 7, 1, 5, 8, 2, 6, 4, 0};
+    vector<int> priorities = {5, 3, 8, 1, 9, 2, 7, 4, 6, 0};
+    PQ<int, int, DenseIndex<int>> grown(tasks, priorities);
+    cout << "Deleting all mins:";
+    bool ordered = true;
+    int last = -1;
+    while (!grown.isEmpty()) {
+        int p = grown.findMinPriority();
+        ordered = ordered && last <= p;
+        last = p;
+        cout << " " << grown.deleteMin();
+    }
+    cout << endl;
+    // a rejected ID must leave the queue exactly as it was
+    PQ<uint32_t> dense;
+    dense.insert(0, 7);
+    int rejections = 0;
+    try {
+        dense.insert(50000, 1);
+    }
+    catch (IllegalArgumentException &) {
+        rejections++;
+    }
+    try {
+        dense.updatePriority(60000, 1);
+    }
+    catch (IllegalArgumentException &) {
+        rejections++;
+    }
+    bool rejected = rejections == 2 && dense.size() == 1 && dense.findMinPriority() == 7
+                    && dense.deleteMin() == 0 && dense.isEmpty();
+    TaskPool pool(2);
+    tasks.push_back(3);
+    priorities.push_back(1);
+    bool duplicate = false;
+    try {
+        PQ<uint32_t> bad(vector<uint32_t>(tasks.begin(), tasks.end()), priorities, pool);
+    }
+    catch (IllegalArgumentException &) {
+        duplicate = true;
+    }
+    cout << "Drained in order; out-of-universe and repeated IDs rejected: "
+         << (ordered && rejected && duplicate ? "PASS" : "FAIL") << endl;
+
+    cout << endl << "------------------ END TEST DENSE INDEX ------------------ " << endl << endl;
+}
+
+DetachedTask popOnce(AsyncPQ<int> & q, int waiterPriority, vector<int> & got) {
+    int x = co_await q.pop(waiterPriority);
+    got[waiterPriority] = x;
+}
+
+DetachedTask drain(AsyncPQ<int> & q, mutex & m, long long & sum, int & count, int & finished) {
+    try {
+        while (true) {
+            int x = co_await q.pop();
+            lock_guard<mutex> lock(m);
+            sum += x;
+            count++;
+        }
+    }
+    catch (UnderflowException &) {
+        lock_guard<mutex> lock(m);
+        finished++;
+    }
+}
+
+void testAsyncPQ() {
+    cout << "------------------ START TEST ASYNC PQ ------------------ " << endl << endl;
+
+    cout << "Three consumers await an empty AsyncPQ<int> with waiter priorities 2, 0, 1..." << endl;
+    AsyncPQ<int> q;
+    vector<int> got(3, -1);
+    popOnce(q, 2, got);
+    popOnce(q, 0, got);
+    popOnce(q, 1, got);
+    cout << "Suspended consumers: " << q.waiting() << endl;
+    cout << "Inserting IDs 100, 200, 300 with priorities 3, 1, 2 in one batch..." << endl;
+    q.insertBatch({100, 200, 300}, {3, 1, 2});
+    cout << "Consumers 0, 1, 2 received: " << got[0] << " " << got[1] << " " << got[2] << endl;
+    bool ordered = got[0] == 200 && got[1] == 300 && got[2] == 100 && q.waiting() == 0 && q.isEmpty();
+    cout << "Most urgent waiter gets the most urgent task: " << (ordered ? "PASS" : "FAIL") << endl << endl;
+
+    const int PER_THREAD = 20000;
+    cout << "Two consumer coroutines drain " << 4 * PER_THREAD << " tasks inserted by four threads..." << endl;
+    AsyncPQ<int> work(true);
+    mutex m;
+    long long sum = 0;
+    int count = 0, finished = 0;
+    drain(work, m, sum, count, finished);
+    drain(work, m, sum, count, finished);
+    vector<thread> producers;
+    for (int t = 0; t < 4; t++) {
+        producers.emplace_back([&work, t] {
+            for (int i = 0; i < PER_THREAD; i++) {
+                work.insert(t * PER_THREAD + i, i % 100);
+            }
+        });
+    }
+    for (size_t t = 0; t < producers.size(); t++) {
+        producers[t].join();
+    }
+    long long n = 4 * PER_THREAD;
+    bool drained = count == n && sum == n * (n - 1) / 2 && work.isEmpty() && work.waiting() == 2;
+    work.shutdown();
+    cout << "Every task consumed once, then shutdown ends both consumers: "
+         << (drained && finished == 2 ? "PASS" : "FAIL") << endl;
+
+    cout << "A consumer awaits an AsyncPQ<int> with an executor that only collects woken handles..." << endl;
+    vector<coroutine_handle<>> posted;
+    AsyncPQ<int> deferred([&posted](coroutine_handle<> h) { posted.push_back(h); });
+    vector<int> late(1, -1);
+    popOnce(deferred, 0, late);
+    deferred.insert(7, 1);
+    bool handedOver = posted.size() == 1 && late[0] == -1 && deferred.waiting() == 0;
+    posted[0].resume();
+    cout << "Woken consumer runs only when the executor resumes it: "
+         << (handedOver && late[0] == 7 ? "PASS" : "FAIL") << endl;
+
+    cout << endl << "------------------ END TEST ASYNC PQ ------------------ " << endl << endl;
+}
+
+void testAging() {
+    cout << "------------------ START TEST AGING ------------------ " << endl << endl;
+
+    const int OPS = 200000;
+    cout << "Running " << OPS << " mixed operations, including ageAll with deltas up to 10^8, on a PQ<int>..." << endl;
+    // priorities fall past INT_MIN many times over, so the queue must rebase
+    // its offset and saturate; the model saturates each task the same way
+    PQ<int> q;
+    vector<long long> model(2000, LLONG_MAX);   // LLONG_MAX: not queued
+    unsigned int rng = 99;
+    bool agree = true;
+    int agings = 0;
+    for (int i = 0; i < OPS && agree; i++) {
+        rng = rng * 1103515245 + 12345;
+        int op = (rng >> 16) % 5;
+        rng = rng * 1103515245 + 12345;
+        int x = (rng >> 8) % 2000;
+        int p = (int) (rng * 2654435761u);
+        if (op == 0) {
+            q.updatePriority(x, p);
+            model[x] = p;
+        }
+        else if (op == 1) {
+            q.remove(x);
+            model[x] = LLONG_MAX;
+        }
+        else if (op == 2 && !q.isEmpty()) {
+            long long minPriority = LLONG_MAX;
+            for (size_t y = 0; y < model.size(); y++) {
+                minPriority = min(minPriority, model[y]);
+            }
+            agree = q.findMinPriority() == minPriority;
+            int id = q.deleteMin();
+            agree = agree && model[id] == minPriority;
+            model[id] = LLONG_MAX;
+        }
+        else if (op == 3) {
+            int delta = (rng >> 4) % 100000000;
+            q.ageAll(delta);
+            agings++;
+            for (size_t y = 0; y < model.size(); y++) {
+                if (model[y] != LLONG_MAX) {
+                    model[y] = max(model[y] - delta, (long long) INT_MIN);
+                }
+            }
+        }
+        else if (!q.contains(x)) {
+            q.insert(x, p);
+            model[x] = p;
+        }
+    }
+    cout << "ageAll calls: " << agings << endl;
+    cout << "Aged priorities match the model: " << (agree ? "PASS" : "FAIL") << endl << endl;
+
+    bool rejected = false;
+    try {
+        q.ageAll(-1);
+    }
+    catch (IllegalArgumentException &) {
+        rejected = true;
+    }
+    cout << "Negative delta rejected with IllegalArgumentException: " << (rejected ? "PASS" : "FAIL") << endl << endl;
+
+    cout << "AgingPQ with 2 classes: class 0 holds IDs 1-3 at priorities 100-102, class 1 holds IDs 4-6 at 50-52..." << endl;
+    AgingPQ<int> classes(2, true);
+    for (int i = 0; i < 3; i++) {
+        classes.insert(1 + i, 100 + i, 0);
+        classes.insert(4 + i, 50 + i, 1);
+    }
+    cout << "Aging class 0 by 60, then moving ID 6 to class 0 at priority 45..." << endl;
+    classes.ageClass(0, 60);
+    classes.updatePriority(6, 45, 0);
+    cout << "Deleting all mins:";
+    vector<int> order;
+    while (!classes.isEmpty()) {
+        order.push_back(classes.deleteMin());
+        cout << " " << order.back();
+    }
+    cout << endl;
+    bool classOrder = order == vector<int>{1, 2, 3, 6, 4, 5};
+    cout << "Classes age independently: " << (classOrder ? "PASS" : "FAIL") << endl;
+
+    cout << "Inserting ID 7 into class 0, then inserting it again into class 1..." << endl;
+    classes.insert(7, 10, 0);
+    classes.insert(7, 20, 1);
+    bool moved = classes.size() == 1 && classes.classOf(7) == 1 && classes.findMinPriority() == 20;
+    classes.remove(7);
+    cout << "Re-inserting a queued ID moves it, leaving no copy behind: "
+         << (moved && classes.isEmpty() && !classes.contains(7) ? "PASS" : "FAIL") << endl;
+
+    cout << endl << "------------------ END TEST AGING ------------------ " << endl << endl;
+}
+
 int main () {
     
     testHeapify();
@@ -179,6 +1059,18 @@ int main () {
     testUpdatePriority();
     testDeleteMin();
     testEverything();
+    testStableFIFO();
+    testMerge();
+    testSplit();
+    testTimerQueue();
+    testWheelPQ();
+    testParallelBuild();
+    testExternalPQ();
+    testFixedPQ();
+    testBTreeIndex();
+    testDenseIndex();
+    testAsyncPQ();
+    testAging();
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,164 @@
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// TaskPool class
+//
+// A fixed set of std::thread workers draining a shared task list.
+// Used by PQ's parallel construction path.
+//
+// CONSTRUCTION: number of worker threads (0 = one per hardware thread)
+//
+// ******************PUBLIC OPERATIONS*********************
+// int size( )                     --> Return the number of worker threads
+// void submit( task )             --> Queue task to run on a worker
+// void wait( )                    --> Block until every submitted task has finished
+// void parallelFor( b, e, fn )    --> Run fn( lo, hi ) over chunks of [b, e) and wait
+//
+// parallelSort( v, less, pool )  --> Sort vector v on the pool's workers
+// ******************ERRORS********************************
+// Tasks must not throw, and must not call wait or parallelFor themselves
+
+class TaskPool {
+
+  public:
+
+    explicit TaskPool( int threads = 0 ) : pending(0), stopping(false) {
+      if (threads <= 0) {
+        threads = max(1u, thread::hardware_concurrency());
+      }
+      for (int i = 0; i < threads; i++) {
+        workers.emplace_back([this] { workerLoop(); });
+      }
+    }
+
+    ~TaskPool() {
+      {
+        lock_guard<mutex> lock(m);
+        stopping = true;
+      }
+      ready.notify_all();
+      for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+      }
+    }
+
+    TaskPool( const TaskPool & ) = delete;
+    TaskPool & operator=( const TaskPool & ) = delete;
+
+    // Return the number of worker threads
+    int size() const { return workers.size(); }
+
+    // Queue task to run on the next free worker
+    void submit( function<void()> task ) {
+      {
+        lock_guard<mutex> lock(m);
+        tasks.push_back(std::move(task));
+        pending++;
+      }
+      ready.notify_one();
+    }
+
+    // Block until every submitted task has finished
+    void wait() {
+      unique_lock<mutex> lock(m);
+      done.wait(lock, [this] { return pending == 0; });
+    }
+
+    // Split [begin, end) into a few chunks per worker, run fn( lo, hi ) on
+    // each in parallel and wait for all of them
+    template <typename F>
+    void parallelFor( long begin, long end, F fn ) {
+      long length = end - begin;
+      if (length <= 0) {
+        return;
+      }
+      long chunks = min(length, (long) size() * 4);
+      for (long c = 0; c < chunks; c++) {
+        long lo = begin + length * c / chunks;
+        long hi = begin + length * (c + 1) / chunks;
+        submit([fn, lo, hi] { fn(lo, hi); });
+      }
+      wait();
+    }
+
+  private:
+
+    vector<thread> workers;
+    deque<function<void()>> tasks;
+    mutex m;
+    condition_variable ready;   // signalled when a task is queued or on shutdown
+    condition_variable done;    // signalled when pending drops to 0
+    int pending;                // tasks queued or running
+    bool stopping;
+
+    void workerLoop() {
+      while (true) {
+        function<void()> task;
+        {
+          unique_lock<mutex> lock(m);
+          ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+          if (tasks.empty()) {
+            return;
+          }
+          task = std::move(tasks.front());
+          tasks.pop_front();
+        }
+        task();
+        {
+          lock_guard<mutex> lock(m);
+          pending--;
+          if (pending == 0) {
+            done.notify_all();
+          }
+        }
+      }
+    }
+};
+
+// Sort v by less: one run per worker is sorted in parallel, then
+// neighbouring runs are merged pairwise in parallel until one remains
+template <typename T, typename Less>
+void parallelSort( vector<T> & v, Less less, TaskPool & pool ) {
+  size_t n = v.size();
+  size_t runs = min(n, (size_t) pool.size());
+  vector<size_t> bounds;
+  for (size_t r = 0; r <= runs; r++) {
+    bounds.push_back(runs == 0 ? 0 : n * r / runs);
+  }
+  for (size_t r = 0; r < runs; r++) {
+    size_t lo = bounds[r], hi = bounds[r + 1];
+    pool.submit([&v, less, lo, hi] {
+      sort(v.begin() + lo, v.begin() + hi, less);
+    });
+  }
+  pool.wait();
+
+  vector<T> buffer(n);
+  while (bounds.size() > 2) {
+    vector<size_t> merged;
+    for (size_t r = 0; r + 1 < bounds.size(); r += 2) {
+      merged.push_back(bounds[r]);
+      size_t lo = bounds[r];
+      size_t mid = bounds[r + 1];
+      size_t hi = (r + 2 < bounds.size()) ? bounds[r + 2] : mid;
+      pool.submit([&v, &buffer, less, lo, mid, hi] {
+        merge(v.begin() + lo, v.begin() + mid, v.begin() + mid, v.begin() + hi,
+              buffer.begin() + lo, less);
+      });
+    }
+    merged.push_back(n);
+    pool.wait();
+    v.swap(buffer);
+    bounds.swap(merged);
+  }
+}
+#endif
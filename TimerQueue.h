@@ -0,0 +1,152 @@
+#ifndef TIMER_QUEUE_H
+#define TIMER_QUEUE_H
+
+#include "dsexceptions.h"
+#include "PQ.h"
+#include <chrono>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+using namespace std;
+
+// TimerQueue class
+//
+// A thread-safe timer queue built on PQ<ID, long long>: the priority of each
+// task is its deadline in epoch milliseconds. Tasks with equal deadlines
+// come due in the order they were scheduled.
+//
+// Template parameter: ID
+// Constructors:
+// TimerQueue --> constructs a new empty timer queue
+// ******************PUBLIC OPERATIONS*********************
+// void schedule( x, deadline )     --> Schedule ID x at deadline (reschedules x if already queued)
+// void scheduleAfter( x, delay )   --> Schedule ID x delay milliseconds from now
+// bool cancel( x )                 --> Remove ID x; return false if x was not queued
+// int popExpired( now, out )       --> Append every ID due at or before now to out; return the count
+// long long nextDeadline( )        --> Return the earliest deadline
+// bool waitPop( out )              --> Block until an ID is due and pop it into out; false after shutdown
+// void shutdown( )                 --> Wake all waiting threads; waitPop returns false from then on
+// bool isEmpty( )                  --> Return true if empty; else false
+// int size( )                      --> Return the number of scheduled IDs
+// static long long now( )          --> Return the current time in epoch milliseconds
+// ******************ERRORS********************************
+// Throws UnderflowException from nextDeadline if empty
+
+template <typename ID>
+class TimerQueue {
+
+  public:
+
+    // Constructor
+    // Initializes a new empty timer queue
+    TimerQueue() : queue(true), closed(false) {}
+
+    // Schedule ID x to come due at deadline (epoch millis)
+    //    If x is already scheduled, its deadline is replaced
+    void schedule( const ID & x, long long deadline ) {
+      lock_guard<mutex> lock(m);
+      // only a new earliest deadline changes how long the waiters should sleep
+      bool earliest = queue.isEmpty() || deadline < queue.findMinPriority();
+      queue.updatePriority(x, deadline);
+      if (earliest) {
+        cv.notify_all();
+      }
+    }
+
+    // Schedule ID x to come due delay milliseconds from now
+    void scheduleAfter( const ID & x, long long delay ) {
+      schedule(x, now() + delay);
+    }
+
+    // Remove ID x from the queue
+    //    Returns false if x was not scheduled
+    bool cancel( const ID & x ) {
+      lock_guard<mutex> lock(m);
+      if (queue.contains(x) == false) {
+        return false;
+      }
+      queue.remove(x);
+      return true;
+    }
+
+    // Append all IDs whose deadline is at or before now to out, earliest first
+    //    Returns the number of IDs appended
+    int popExpired( long long now, vector<ID> & out ) {
+      lock_guard<mutex> lock(m);
+      int count = 0;
+      while (!queue.isEmpty() && queue.findMinPriority() <= now) {
+        out.push_back(queue.deleteMin());
+        count++;
+      }
+      return count;
+    }
+
+    // Returns the earliest deadline, e.g. to compute how long to sleep
+    //    Throws exception if queue is empty
+    long long nextDeadline() const {
+      lock_guard<mutex> lock(m);
+      return queue.findMinPriority();
+    }
+
+    // Block until the earliest ID is due, then remove it into out
+    //    Sleeps on a timed wait until the next deadline rather than polling;
+    //    wakes early if an earlier deadline is scheduled
+    //    Returns false once shutdown() has been called
+    bool waitPop( ID & out ) {
+      unique_lock<mutex> lock(m);
+      while (true) {
+        if (closed) {
+          return false;
+        }
+        if (queue.isEmpty()) {
+          cv.wait(lock);
+          continue;
+        }
+        long long deadline = queue.findMinPriority();
+        long long current = now();
+        if (deadline <= current) {
+          out = queue.deleteMin();
+          return true;
+        }
+        // a far deadline (e.g. LLONG_MAX for "never") does not fit the
+        // clock's nanosecond count, so sleep at most MAX_WAIT and recheck
+        cv.wait_for(lock, chrono::milliseconds(min(deadline - current, MAX_WAIT)));
+      }
+    }
+
+    // Wake every thread blocked in waitPop and make it return false
+    void shutdown() {
+      lock_guard<mutex> lock(m);
+      closed = true;
+      cv.notify_all();
+    }
+
+    // Emptiness check
+    bool isEmpty() const {
+      lock_guard<mutex> lock(m);
+      return queue.isEmpty();
+    }
+
+    // Return the number of scheduled IDs
+    int size() const {
+      lock_guard<mutex> lock(m);
+      return queue.size();
+    }
+
+    // Current time in epoch milliseconds, the unit of all deadlines
+    static long long now() {
+      return chrono::duration_cast<chrono::milliseconds>(
+          chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+  private:
+
+    static constexpr long long MAX_WAIT = 24LL * 60 * 60 * 1000;   // one day, in millis
+
+    PQ<ID, long long> queue;
+    mutable mutex m;
+    condition_variable cv;
+    bool closed;
+};
+#endif
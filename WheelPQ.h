@@ -0,0 +1,305 @@
+#ifndef WHEEL_PQ_H
+#define WHEEL_PQ_H
+
+#include "dsexceptions.h"
+#include "PQ.h"
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// WheelPQ class
+//
+// A priority queue for priorities that cluster just ahead of a moving
+// "now" (e.g. deadlines in milliseconds). Priorities in the window
+// [now, now + slots) live in a timing wheel with one bucket per priority
+// value, so insert and deleteMin are O(1). Priorities beyond the window
+// spill into a PQ and are pulled forward into the wheel as now advances;
+// priorities already behind now go to a second PQ and are served first.
+// Equal priorities in the wheel are removed in FIFO order.
+//
+// Template parameter: ID (must be Comparable and hashable with std::hash)
+// Constructors:
+// WheelPQ( slots, start ) --> constructs an empty queue whose wheel has slots
+//                             buckets (rounded up to a power of two), with now = start
+// ******************PUBLIC OPERATIONS*********************
+// void insert( x, p )          --> Insert task ID x with priority p
+// ID findMin( )                --> Return a task ID with smallest priority, without removing it
+// long long findMinPriority( ) --> Return the smallest priority, without removing it
+// ID deleteMin( )              --> Remove and return a task ID with smallest priority
+// void updatePriority( x, p )  --> Changes priority of ID x to p (if x not in queue, inserts x)
+// void remove( x )             --> Remove task ID x; nothing is done if x is not in the queue
+// bool contains( x )           --> Return true if task ID x is in the queue
+// void advance( t )            --> Move now forward to t (or to the earliest wheel entry, if sooner)
+// long long now( )             --> Return the start of the wheel window
+// int spilled( )               --> Return the number of task IDs held outside the wheel
+// bool isEmpty( )              --> Return true if empty; else false
+// int size( )                  --> Return the number of task IDs in the queue
+// ******************ERRORS********************************
+// Throws UnderflowException as warranted
+
+template <typename ID>
+class WheelPQ {
+
+  public:
+
+    // Constructor
+    // Initializes an empty queue with a wheel of (at least) slots buckets
+    // covering priorities [start, start + slots)
+    explicit WheelPQ( int slots = 4096, long long start = 0 )
+      : far(true), late(true), cursor(start), wheelCount(0), freeList(-1) {
+      int s = 64;
+      while (s < slots) {
+        s *= 2;
+      }
+      mask = s - 1;
+      heads.assign(s, -1);
+      tails.assign(s, -1);
+      occupied.assign(s / 64, 0);
+    }
+
+    // Emptiness check
+    bool isEmpty() const { return size() == 0; }
+
+    // Return the number of task IDs in the queue
+    int size() const {
+      return wheelCount + far.size() + late.size();
+    }
+
+    // Return the number of task IDs held in the spill heaps rather than the wheel
+    int spilled() const {
+      return far.size() + late.size();
+    }
+
+    // Start of the wheel window
+    long long now() const { return cursor; }
+
+    // Returns true if ID x is in the queue
+    bool contains( const ID & x ) const {
+      return where.count(x) > 0;
+    }
+
+    // Insert ID x with priority p.
+    void insert( const ID & x, long long p ) {
+      if (p < cursor) {
+        late.insert(x, p);
+        where[x] = LATE;
+      }
+      else if (!beyondWindow(p)) {
+        where[x] = wheelInsert(x, p);
+      }
+      else {
+        far.insert(x, p);
+        where[x] = FAR;
+      }
+    }
+
+    // Returns an ID with minimum priority without removing it
+    //     Throws exception if queue is empty
+    const ID & findMin() const {
+      if (!late.isEmpty()) {
+        return late.findMin();
+      }
+      if (wheelCount > 0) {
+        return entries[heads[firstSlot()]].id;
+      }
+      return far.findMin();
+    }
+
+    // Returns the minimum priority without removing its task
+    //     Throws exception if queue is empty
+    long long findMinPriority() const {
+      if (!late.isEmpty()) {
+        return late.findMinPriority();
+      }
+      if (wheelCount > 0) {
+        return entries[heads[firstSlot()]].priority;
+      }
+      return far.findMinPriority();
+    }
+
+    // Deletes and Returns a task ID with minimum priority
+    //    Throws exception if queue is empty
+    //    now advances to the removed priority
+    ID deleteMin() {
+      if (!late.isEmpty()) {
+        ID x = late.deleteMin();
+        where.erase(x);
+        return x;
+      }
+      if (wheelCount == 0) {
+        if (far.isEmpty()) {
+          throw UnderflowException{ };
+        }
+        advanceTo(far.findMinPriority());
+      }
+
+      int e = heads[firstSlot()];
+      ID x = entries[e].id;
+      long long p = entries[e].priority;
+      wheelRemove(e);
+      where.erase(x);
+      advanceTo(p);
+      return x;
+    }
+
+    // Update the priority of ID x to p
+    //    Inserts x with p if not in the queue
+    void updatePriority( const ID & x, long long p ) {
+      remove(x);
+      insert(x, p);
+    }
+
+    // Remove ID x from the queue; nothing is done if x is not in the queue
+    void remove( const ID & x ) {
+      typename unordered_map<ID, int>::iterator it = where.find(x);
+      if (it == where.end()) {
+        return;
+      }
+      if (it->second == LATE) {
+        late.remove(x);
+      }
+      else if (it->second == FAR) {
+        far.remove(x);
+      }
+      else {
+        wheelRemove(it->second);
+      }
+      where.erase(it);
+    }
+
+    // Move the window forward to t, pulling spilled entries that now fall
+    // inside it into the wheel. now never passes the earliest entry at or
+    // beyond it, whether in the wheel or spilled far ahead.
+    void advance( long long t ) {
+      if (wheelCount > 0) {
+        long long earliest = entries[heads[firstSlot()]].priority;
+        if (earliest < t) {
+          t = earliest;
+        }
+      }
+      else if (!far.isEmpty() && far.findMinPriority() < t) {
+        t = far.findMinPriority();
+      }
+      advanceTo(t);
+    }
+
+  private:
+
+    // Locations recorded in where for IDs outside the wheel; wheel IDs
+    // map to their entry index
+    static const int FAR = -1;
+    static const int LATE = -2;
+
+    struct WheelEntry {
+      ID id;
+      long long priority;
+      int prev;
+      int next;
+    };
+
+    PQ<ID, long long> far;    // priorities at or beyond cursor + slots
+    PQ<ID, long long> late;   // priorities behind cursor
+    long long cursor;         // start of the wheel window
+    long long mask;           // slots - 1
+    int wheelCount;
+    int freeList;             // chain of unused entries, linked through next
+    vector<WheelEntry> entries;
+    vector<int> heads;        // per-slot FIFO list of entries
+    vector<int> tails;
+    vector<unsigned long long> occupied;  // one bit per non-empty slot
+    unordered_map<ID, int> where;
+
+    // Append x to the bucket for p, which must lie in the window
+    int wheelInsert( const ID & x, long long p ) {
+      int e;
+      if (freeList >= 0) {
+        e = freeList;
+        freeList = entries[e].next;
+        entries[e].id = x;
+      }
+      else {
+        e = entries.size();
+        entries.push_back(WheelEntry{ x, 0, -1, -1 });
+      }
+      int s = p & mask;
+      entries[e].priority = p;
+      entries[e].prev = tails[s];
+      entries[e].next = -1;
+      if (tails[s] >= 0) {
+        entries[tails[s]].next = e;
+      }
+      else {
+        heads[s] = e;
+        occupied[s / 64] |= 1ULL << (s % 64);
+      }
+      tails[s] = e;
+      wheelCount++;
+      return e;
+    }
+
+    // Unlink entry e from its bucket and recycle it
+    void wheelRemove( int e ) {
+      int s = entries[e].priority & mask;
+      if (entries[e].prev >= 0) {
+        entries[entries[e].prev].next = entries[e].next;
+      }
+      else {
+        heads[s] = entries[e].next;
+      }
+      if (entries[e].next >= 0) {
+        entries[entries[e].next].prev = entries[e].prev;
+      }
+      else {
+        tails[s] = entries[e].prev;
+      }
+      if (heads[s] < 0) {
+        occupied[s / 64] &= ~(1ULL << (s % 64));
+      }
+      entries[e].next = freeList;
+      freeList = e;
+      wheelCount--;
+    }
+
+    // True if p lies past the end of the wheel window; the distance from the
+    // cursor is taken in unsigned arithmetic, as p - cursor can overflow
+    bool beyondWindow( long long p ) const {
+      return p > cursor && (unsigned long long) p - (unsigned long long) cursor > (unsigned long long) mask;
+    }
+
+    // First non-empty slot at or after the cursor; the wheel must be non-empty
+    int firstSlot() const {
+      int words = occupied.size();
+      int start = cursor & mask;
+      int w = start / 64;
+      unsigned long long bits = occupied[w] & (~0ULL << (start % 64));
+      for (int i = 0; i <= words; i++) {
+        if (bits != 0) {
+          return w * 64 + __builtin_ctzll(bits);
+        }
+        w = (w + 1) % words;
+        bits = occupied[w];
+      }
+      return start;
+    }
+
+    // Set the cursor to t (if later) and migrate far entries into the window
+    void advanceTo( long long t ) {
+      if (t <= cursor) {
+        return;
+      }
+      cursor = t;
+      while (!far.isEmpty() && !beyondWindow(far.findMinPriority())) {
+        long long p = far.findMinPriority();
+        ID x = far.deleteMin();
+        if (p < cursor) {
+          // never file an entry behind the window into the wheel
+          late.insert(x, p);
+          where[x] = LATE;
+        }
+        else {
+          where[x] = wheelInsert(x, p);
+        }
+      }
+    }
+};
+#endif
@@ -7,5 +7,6 @@ class ArrayIndexOutOfBoundsException { };
 class IteratorOutOfBoundsException { };
 class IteratorMismatchException { };
 class IteratorUninitializedException { };
+class IOException { };
 
 #endif
\ No newline at end of file